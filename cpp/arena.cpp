@@ -0,0 +1,40 @@
+// arena.cpp
+#include "arena.h"
+#include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+Arena::~Arena() {
+    for (const Chunk& c : chunks) std::free(c.memory);
+}
+
+void* Arena::allocateSlow(size_t size) {
+    if (size > CHUNK_SIZE) throw std::bad_alloc();
+
+    // Move on to the next chunk that is large enough, allocating one twice
+    // the size of the last the first time we get past the end
+    if (chunk < chunks.size()) {
+        before += chunks[chunk].size;
+        chunk++;
+    }
+    while (chunk < chunks.size() && chunks[chunk].size < size) {
+        before += chunks[chunk].size;
+        chunk++;
+    }
+    if (chunk == chunks.size()) {
+        size_t chunkSize = chunks.empty() ? MIN_CHUNK_SIZE : std::min(2 * chunks.back().size, CHUNK_SIZE);
+        while (chunkSize < size) chunkSize *= 2;
+        bool huge = hugePages && chunkSize == CHUNK_SIZE;
+        void* memory = huge ? std::aligned_alloc(CHUNK_SIZE, CHUNK_SIZE) : std::malloc(chunkSize);
+        if (!memory) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        if (huge) madvise(memory, CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+        chunks.push_back({(char*) memory, chunkSize});
+    }
+
+    used = size;
+    return chunks[chunk].memory;
+}
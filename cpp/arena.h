@@ -0,0 +1,175 @@
+// arena.h
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for search trees. Objects are carved out of chunks that
+// start at 16 KiB and double up to 2 MiB, so the many small trees of the
+// multiple-board searches stay small while a large tree soon works in 2 MiB
+// chunks. reset() hands everything back at once without walking the tree.
+// Chunks are kept between resets, so a search that reuses its arena stops
+// touching malloc after the first few moves.
+//
+// Nothing allocated here is ever destroyed, so only trivially destructible
+// types are allowed.
+class Arena {
+public:
+    static constexpr size_t MIN_CHUNK_SIZE = 16 << 10;
+    static constexpr size_t CHUNK_SIZE = 2 << 20;
+
+    // With hugePages, full-size chunks are 2 MiB aligned and the kernel is
+    // asked to back them with transparent huge pages, cutting TLB misses on
+    // large trees.
+    explicit Arena(bool hugePages = true) : hugePages(hugePages), chunk(0), used(0), before(0) {}
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // n value-initialized objects
+    template <class T>
+    T* makeArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+        return new (allocate(n * sizeof(T), alignof(T))) T[n]();
+    }
+
+    void* allocate(size_t size, size_t align) {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (chunk < chunks.size() && offset + size <= chunks[chunk].size) {
+            used = offset + size;
+            return chunks[chunk].memory + offset;
+        }
+        return allocateSlow(size);
+    }
+
+    // Free everything at once. O(1), the chunks are reused.
+    void reset() {
+        chunk = 0;
+        used = 0;
+        before = 0;
+    }
+
+    // Bytes handed out since the last reset, including alignment padding and
+    // the unused ends of earlier chunks
+    size_t bytesUsed() const { return before + used; }
+
+private:
+    struct Chunk {
+        char* memory;
+        size_t size;
+    };
+
+    void* allocateSlow(size_t size);
+
+    bool hugePages;
+    std::vector<Chunk> chunks;
+    // Allocation position: chunks[chunk] is filled up to used, and the chunks
+    // before it hold before bytes
+    size_t chunk;
+    size_t used;
+    size_t before;
+};
+
+// Objects of one type addressed by 32-bit indices, half the size of a pointer.
+// Storage is a list of arena blocks that never move, so references stay valid
+// while the pool grows. The list of blocks never moves either, so objects can
+// be read while another thread adds more (adding itself needs a lock).
+//
+// The first block holds 4 KiB of objects and each next one twice as many, up
+// to one full 2 MiB chunk, after which every block is full-size. A small tree
+// thus only initializes about twice the memory it uses. Shifted by FIRST, an
+// index's highest bit names its block, so finding it costs a bit scan.
+template <class T>
+class Pool {
+public:
+    explicit Pool(bool hugePages = true) : arena(hugePages), count(0), capacity(0) {
+        static_assert(FIRST_SHIFT >= 0, "Objects must be at most 4 KiB");
+        blocks.reserve(MAX_BLOCKS);
+    }
+
+    T& operator[](uint32_t i) { return blocks[block(i)][offset(i)]; }
+    const T& operator[](uint32_t i) const { return blocks[block(i)][offset(i)]; }
+
+    // Append a value-initialized object and return its index
+    uint32_t add() {
+        if (count == capacity) addBlock();
+        return count++;
+    }
+
+    // Append n contiguous value-initialized objects and return the first index.
+    // n must fit in one full-size block; the rest of the current block is
+    // skipped if needed.
+    uint32_t addRange(uint32_t n) {
+        if (n > PER_BLOCK) throw std::bad_alloc();
+        uint32_t first = count;
+        while (offset(first) + n > blockSize(block(first))) first += blockSize(block(first)) - offset(first);
+        while (capacity < (uint64_t) first + n) addBlock();
+        count = first + n;
+        return first;
+    }
+
+    uint32_t size() const { return count; }
+
+    // Largest range addRange accepts
+    static constexpr uint32_t maxRange() { return PER_BLOCK; }
+
+    // Drop every object at once. O(1), the chunks are reused.
+    void reset() {
+        arena.reset();
+        blocks.clear();
+        count = 0;
+        capacity = 0;
+    }
+
+private:
+    static constexpr int log2Floor(size_t n) { return n <= 1 ? 0 : 1 + log2Floor(n / 2); }
+
+    // Objects per full-size block, rounded down to a power of two for cheap
+    // indexing, and in the first block
+    static constexpr int SHIFT = log2Floor(Arena::CHUNK_SIZE / sizeof(T));
+    static constexpr uint32_t PER_BLOCK = 1u << SHIFT;
+    static constexpr uint32_t MASK = PER_BLOCK - 1;
+    static constexpr int FIRST_SHIFT = SHIFT - log2Floor(Arena::CHUNK_SIZE / 4096);
+    static constexpr uint32_t FIRST = 1u << FIRST_SHIFT;
+    // Growing blocks before the first full-size one
+    static constexpr int GROWING = SHIFT - FIRST_SHIFT;
+    // Enough blocks for every 32-bit index
+    static constexpr size_t MAX_BLOCKS = GROWING + ((uint64_t(UINT32_MAX) + FIRST) >> SHIFT);
+
+    // Growing blocks cover index + FIRST in [FIRST << b, FIRST << (b + 1)),
+    // full-size ones a multiple of PER_BLOCK onwards
+    static int level(uint32_t i) {
+        return std::min(63 - __builtin_clzll((uint64_t) i + FIRST), SHIFT);
+    }
+    static uint32_t block(uint32_t i) {
+        uint64_t full = ((uint64_t) i + FIRST) >> SHIFT;
+        return level(i) - FIRST_SHIFT + full - (full != 0);
+    }
+    static uint32_t offset(uint32_t i) {
+        return (uint32_t) (((uint64_t) i + FIRST) & ((uint64_t(1) << level(i)) - 1));
+    }
+    static uint32_t blockSize(uint32_t b) { return b < GROWING ? FIRST << b : PER_BLOCK; }
+
+    void addBlock() {
+        if (blocks.size() == MAX_BLOCKS) throw std::bad_alloc();
+        uint32_t n = blockSize((uint32_t) blocks.size());
+        blocks.push_back(arena.makeArray<T>(n));
+        capacity += n;
+    }
+
+    Arena arena;
+    std::vector<T*> blocks;
+    uint32_t count;
+    // Objects the blocks can hold
+    uint64_t capacity;
+};
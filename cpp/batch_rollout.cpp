@@ -0,0 +1,174 @@
+// batch_rollout.cpp
+#include "batch_rollout.h"
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Structure-of-arrays state of one batch. Board b of lane i is boards[b * BATCH_LANES + i].
+// Live lanes are kept in [0, active); lane i started as rollout id[i].
+struct Batch {
+    int numBoards;
+    int active;
+    std::vector<Board> boards;
+    std::vector<Board> scratch;
+    Rng rng[BATCH_LANES];
+    int id[BATCH_LANES];
+    int score[BATCH_LANES];
+    bool dead[BATCH_LANES];
+    int64_t dirs[BATCH_LANES];
+    int64_t reward[BATCH_LANES];
+    int64_t merges[BATCH_LANES];
+    int64_t changed[BATCH_LANES];
+
+    Board* lane(int b) { return &boards[b * BATCH_LANES]; }
+
+    // Put a copy of start in each of the first lanes lanes
+    void load(const BoardSet& start, const uint64_t* seeds, int lanes) {
+        numBoards = start.numBoards;
+        active = lanes;
+        boards.resize(start.numBoards * BATCH_LANES);
+        scratch.resize(BATCH_LANES);
+        for (int i = 0; i < lanes; i++) {
+            for (int b = 0; b < start.numBoards; b++) lane(b)[i] = start[b];
+            rng[i].reseed(seeds[i]);
+            id[i] = i;
+            score[i] = 0;
+        }
+    }
+
+    int legalMask(int i) {
+        int mask = 0;
+        for (int b = 0; b < numBoards && mask != ALL_MOVES; b++) mask |= legalMoves(lane(b)[i]);
+        return mask;
+    }
+
+    template <class Policy>
+    void choose(const Policy& policy) {
+        if constexpr (std::is_base_of<WeightedPolicy<Policy>, Policy>::value) {
+            chooseWeighted<Policy>();
+        } else if constexpr (std::is_same<Policy, RandomPolicy>::value) {
+            for (int i = 0; i < active; i++) dirs[i] = randomMove(legalMask(i), rng[i]);
+        } else {
+            BoardSet state;
+            state.numBoards = numBoards;
+            for (int i = 0; i < active; i++) {
+                for (int b = 0; b < numBoards; b++) state[b] = lane(b)[i];
+                dirs[i] = policy.choose(state, legalMask(i), rng[i]);
+            }
+        }
+    }
+
+    // Same arithmetic as WeightedPolicy::choose, so lanes match it draw for draw
+    template <class Policy>
+    void chooseWeighted() {
+        int64_t directionReward[4][BATCH_LANES];
+        int64_t directionMerges[4][BATCH_LANES];
+        for (int move = 0; move < 4; move++) {
+            for (int i = 0; i < active; i++) {
+                dirs[i] = move;
+                directionReward[move][i] = 0;
+                directionMerges[move][i] = 0;
+                changed[i] = 0;
+            }
+            for (int b = 0; b < numBoards; b++) {
+                slideLanes(lane(b), dirs, scratch.data(), directionReward[move],
+                           directionMerges[move], changed, active);
+            }
+        }
+
+        for (int i = 0; i < active; i++) {
+            int legal = legalMask(i);
+            double weights[4] = {0, 0, 0, 0};
+            for (int move = 0; move < 4; move++) {
+                if (!(legal & (1 << move))) continue;
+                StepResult result = {false, true, (int) directionReward[move][i],
+                                     (int) directionMerges[move][i]};
+                weights[move] = Policy::weight(result);
+            }
+            dirs[i] = sampleMove(weights, rng[i]);
+        }
+    }
+
+    // Slide every live lane in dirs[i], then spawn like step() does
+    void step() {
+        for (int i = 0; i < active; i++) {
+            reward[i] = 0;
+            merges[i] = 0;
+            changed[i] = 0;
+        }
+        for (int b = 0; b < numBoards; b++) {
+            slideLanes(lane(b), dirs, lane(b), reward, merges, changed, active);
+        }
+
+        for (int i = 0; i < active; i++) {
+            score[i] += reward[i];
+            dead[i] = false;
+            if (!changed[i]) continue;
+            for (int b = 0; b < numBoards; b++) {
+                spawnTile(lane(b)[i], rng[i]);
+                if (isTerminal(lane(b)[i])) {
+                    dead[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Report finished lanes and move the last live lane into their slot
+    void compact(int* scores) {
+        for (int i = 0; i < active;) {
+            if (!dead[i]) {
+                i++;
+                continue;
+            }
+            scores[id[i]] = score[i];
+            int last = --active;
+            if (i == last) break;
+            for (int b = 0; b < numBoards; b++) lane(b)[i] = lane(b)[last];
+            rng[i] = rng[last];
+            id[i] = id[last];
+            score[i] = score[last];
+            dead[i] = dead[last];
+        }
+    }
+};
+
+}
+
+template <class Policy>
+void batchRollout(const BoardSet& start, int firstMove, const uint64_t* seeds,
+                  int lanes, int* scores) {
+    Policy policy;
+    Batch batch;
+    batch.load(start, seeds, lanes);
+    for (int i = 0; i < lanes; i++) batch.dirs[i] = firstMove;
+
+    batch.step();
+    batch.compact(scores);
+    while (batch.active > 0) {
+        batch.choose(policy);
+        batch.step();
+        batch.compact(scores);
+    }
+}
+
+template <class Policy>
+void batchRollout(const BoardSet& start, const uint64_t* seeds, int lanes, int* scores) {
+    Policy policy;
+    Batch batch;
+    batch.load(start, seeds, lanes);
+
+    while (batch.active > 0) {
+        batch.choose(policy);
+        batch.step();
+        batch.compact(scores);
+    }
+}
+
+template void batchRollout<RandomPolicy>(const BoardSet&, int, const uint64_t*, int, int*);
+template void batchRollout<MergePolicy>(const BoardSet&, int, const uint64_t*, int, int*);
+template void batchRollout<ScorePolicy>(const BoardSet&, int, const uint64_t*, int, int*);
+template void batchRollout<RandomPolicy>(const BoardSet&, const uint64_t*, int, int*);
+template void batchRollout<MergePolicy>(const BoardSet&, const uint64_t*, int, int*);
+template void batchRollout<ScorePolicy>(const BoardSet&, const uint64_t*, int, int*);
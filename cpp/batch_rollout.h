@@ -0,0 +1,58 @@
+// batch_rollout.h
+#pragma once
+#include <algorithm>
+#include "rollout_policy.h"
+
+// Lock-step batch rollouts for flat Monte Carlo and search leaves. Many copies of a position are
+// played out together in structure-of-arrays form, so the row-table moves of
+// all lanes run through SIMD gathers (AVX-512 or AVX2, with a scalar fallback).
+// Lanes that reach game over are compacted away after every step.
+//
+// Each lane draws from its own generator in the same order as playout() with
+// the same policy, so a lane's score only depends on its seed.
+
+const int BATCH_LANES = 64;
+
+// Play out `lanes` (at most BATCH_LANES) copies of start. Every lane first
+// makes firstMove, then follows Policy until game over. Lane i uses
+// generator seeds[i] and writes its total reward to scores[i].
+//
+// Instantiated for RandomPolicy, MergePolicy and ScorePolicy at the end of
+// batch_rollout.cpp; add a line there for new policies. Weighted
+// policies score all four directions of every lane with SIMD slides; other
+// policies are called once per lane on a copy of its boards.
+template <class Policy>
+void batchRollout(const BoardSet& start, int firstMove, const uint64_t* seeds,
+                  int lanes, int* scores);
+
+// Same, but every lane follows Policy from start, which must not be terminal
+template <class Policy>
+void batchRollout(const BoardSet& start, const uint64_t* seeds, int lanes, int* scores);
+
+// Mean reward of k playouts of state, for evaluating a new search leaf. With
+// k > 1 they run as batches seeded from rng; k = 1 is playout() with rng.
+template <class Policy>
+double meanPlayout(const BoardSet& state, int k, Rng& rng) {
+    if (k <= 1) return playout<Policy>(state, rng);
+
+    uint64_t seeds[BATCH_LANES];
+    int scores[BATCH_LANES];
+    long total = 0;
+    for (int done = 0; done < k; done += BATCH_LANES) {
+        int lanes = std::min(BATCH_LANES, k - done);
+        for (int i = 0; i < lanes; i++) seeds[i] = rng.next();
+        batchRollout<Policy>(state, seeds, lanes, scores);
+        for (int i = 0; i < lanes; i++) total += scores[i];
+    }
+    return (double) total / k;
+}
+
+template <class Policy>
+double meanPlayout(const BoardState& state, int k, Rng& rng) {
+    if (k <= 1) return playout<Policy>(state, rng);
+
+    BoardSet boards;
+    boards.numBoards = 1;
+    boards[0] = state.board;
+    return meanPlayout<Policy>(boards, k, rng);
+}
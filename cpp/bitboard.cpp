@@ -0,0 +1,216 @@
+// bitboard.cpp
+#include "bitboard.h"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__AVX512F__) && defined(__GNUC__) && !defined(__clang__)
+// GCC flags the undefined passthrough operand inside the AVX-512 intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+RowMove rowMoveTables[2][65536];
+
+namespace {
+
+uint16_t reverseRow(uint16_t row) {
+    return (row >> 12) | ((row >> 4) & 0x00F0) | ((row << 4) & 0x0F00) | (row << 12);
+}
+
+RowMove reverseMove(RowMove move) {
+    move.row = reverseRow(move.row);
+    return move;
+}
+
+// Slide one row towards column 3, same rules as the old Game2048::moveLine.
+// Two 2^15 tiles are not merged since 2^16 does not fit in a nibble.
+RowMove slideRowRight(uint16_t row) {
+    int line[4];
+    for (int j = 0; j < 4; j++) line[j] = (row >> (12 - 4 * j)) & 0xF;
+
+    int result[4] = {0, 0, 0, 0};
+    int writePos = 3;
+    bool merged = false;
+    RowMove move = {0, 0, 0, 0};
+    for (int i = 3; i >= 0; i--) {
+        if (line[i] == 0) continue;
+
+        if (result[writePos] == 0) {
+            result[writePos] = line[i];
+        }
+        else if (result[writePos] == line[i] && !merged && line[i] < 15) {
+            result[writePos]++;
+            move.reward += 1u << result[writePos];
+            move.merges++;
+            merged = true;
+        }
+        else {
+            writePos--;
+            result[writePos] = line[i];
+            merged = false;
+        }
+    }
+
+    for (int j = 0; j < 4; j++) move.row |= result[j] << (12 - 4 * j);
+    move.changed = move.row != row;
+    return move;
+}
+
+struct TableInit {
+    TableInit() {
+        for (int row = 0; row < 65536; row++) {
+            rowRightTable[row] = slideRowRight(row);
+            rowLeftTable[row] = reverseMove(slideRowRight(reverseRow(row)));
+        }
+    }
+};
+
+TableInit tableInit;
+
+static_assert(sizeof(RowMove) == 8, "SIMD gathers read a RowMove as one 64-bit word");
+
+
+const long long* const rowTableBase = (const long long*) &rowMoveTables[0][0];
+
+#if defined(__AVX512F__)
+
+inline __m512i transposeLanes(__m512i x) {
+    __m512i a1 = _mm512_and_si512(x, _mm512_set1_epi64(0xF0F00F0FF0F00F0FLL));
+    __m512i a2 = _mm512_and_si512(x, _mm512_set1_epi64(0x0000F0F00000F0F0LL));
+    __m512i a3 = _mm512_and_si512(x, _mm512_set1_epi64(0x0F0F00000F0F0000LL));
+    __m512i a = _mm512_or_si512(a1, _mm512_or_si512(_mm512_slli_epi64(a2, 12), _mm512_srli_epi64(a3, 12)));
+    __m512i b1 = _mm512_and_si512(a, _mm512_set1_epi64(0xFF00FF0000FF00FFLL));
+    __m512i b2 = _mm512_and_si512(a, _mm512_set1_epi64(0x00FF00FF00000000LL));
+    __m512i b3 = _mm512_and_si512(a, _mm512_set1_epi64(0x00000000FF00FF00LL));
+    return _mm512_or_si512(b1, _mm512_or_si512(_mm512_srli_epi64(b2, 24), _mm512_slli_epi64(b3, 24)));
+}
+
+// Look up row SHIFT/16 of every lane and fold the RowMove into the accumulators
+template <int SHIFT>
+inline void gatherRow(__m512i t, __m512i offset, __m512i& rows, __m512i& reward,
+                      __m512i& merges, __m512i& changed) {
+    const __m512i low16 = _mm512_set1_epi64(0xFFFF);
+    const __m512i low8 = _mm512_set1_epi64(0xFF);
+    __m512i index = _mm512_add_epi64(_mm512_and_si512(_mm512_srli_epi64(t, SHIFT), low16), offset);
+    __m512i entry = _mm512_i64gather_epi64(index, rowTableBase, 8);
+    rows = _mm512_or_si512(rows, _mm512_slli_epi64(_mm512_and_si512(entry, low16), SHIFT));
+    merges = _mm512_add_epi64(merges, _mm512_and_si512(_mm512_srli_epi64(entry, 16), low8));
+    changed = _mm512_or_si512(changed, _mm512_and_si512(_mm512_srli_epi64(entry, 24), low8));
+    reward = _mm512_add_epi64(reward, _mm512_srli_epi64(entry, 32));
+}
+
+#elif defined(__AVX2__)
+
+inline __m256i transposeLanes(__m256i x) {
+    __m256i a1 = _mm256_and_si256(x, _mm256_set1_epi64x(0xF0F00F0FF0F00F0FLL));
+    __m256i a2 = _mm256_and_si256(x, _mm256_set1_epi64x(0x0000F0F00000F0F0LL));
+    __m256i a3 = _mm256_and_si256(x, _mm256_set1_epi64x(0x0F0F00000F0F0000LL));
+    __m256i a = _mm256_or_si256(a1, _mm256_or_si256(_mm256_slli_epi64(a2, 12), _mm256_srli_epi64(a3, 12)));
+    __m256i b1 = _mm256_and_si256(a, _mm256_set1_epi64x(0xFF00FF0000FF00FFLL));
+    __m256i b2 = _mm256_and_si256(a, _mm256_set1_epi64x(0x00FF00FF00000000LL));
+    __m256i b3 = _mm256_and_si256(a, _mm256_set1_epi64x(0x00000000FF00FF00LL));
+    return _mm256_or_si256(b1, _mm256_or_si256(_mm256_srli_epi64(b2, 24), _mm256_slli_epi64(b3, 24)));
+}
+
+// Look up row SHIFT/16 of every lane and fold the RowMove into the accumulators
+template <int SHIFT>
+inline void gatherRow(__m256i t, __m256i offset, __m256i& rows, __m256i& reward,
+                      __m256i& merges, __m256i& changed) {
+    const __m256i low16 = _mm256_set1_epi64x(0xFFFF);
+    const __m256i low8 = _mm256_set1_epi64x(0xFF);
+    __m256i index = _mm256_add_epi64(_mm256_and_si256(_mm256_srli_epi64(t, SHIFT), low16), offset);
+    __m256i entry = _mm256_i64gather_epi64(rowTableBase, index, 8);
+    rows = _mm256_or_si256(rows, _mm256_slli_epi64(_mm256_and_si256(entry, low16), SHIFT));
+    merges = _mm256_add_epi64(merges, _mm256_and_si256(_mm256_srli_epi64(entry, 16), low8));
+    changed = _mm256_or_si256(changed, _mm256_and_si256(_mm256_srli_epi64(entry, 24), low8));
+    reward = _mm256_add_epi64(reward, _mm256_srli_epi64(entry, 32));
+}
+
+#endif
+
+}
+
+Board encodeBoard(const std::vector<int>& tiles) {
+    Board b = 0;
+    for (int i = 0; i < 16; i++) {
+        int exponent = 0;
+        for (int tile = tiles[i]; tile > 1; tile /= 2) exponent++;
+        b = setCell(b, i, exponent);
+    }
+    return b;
+}
+
+std::vector<int> decodeBoard(Board b) {
+    std::vector<int> tiles(16);
+    for (int i = 0; i < 16; i++) {
+        int exponent = getCell(b, i);
+        tiles[i] = exponent ? 1 << exponent : 0;
+    }
+    return tiles;
+}
+
+void slideLanes(const Board* in, const int64_t* dirs, Board* out,
+                int64_t* reward, int64_t* merges, int64_t* changed, int n) {
+    int i = 0;
+#if defined(__AVX512F__)
+    for (; i + 8 <= n; i += 8) {
+        __m512i b = _mm512_loadu_si512(in + i);
+        __m512i d = _mm512_loadu_si512(dirs + i);
+        // Up and down work on the transposed board, down and right use the right table
+        __mmask8 vertical = _mm512_cmplt_epi64_mask(d, _mm512_set1_epi64(2));
+        __mmask8 right = _mm512_cmpeq_epi64_mask(d, _mm512_set1_epi64(1)) |
+                         _mm512_cmpeq_epi64_mask(d, _mm512_set1_epi64(2));
+        __m512i offset = _mm512_maskz_mov_epi64(right, _mm512_set1_epi64(65536));
+        __m512i t = _mm512_mask_blend_epi64(vertical, b, transposeLanes(b));
+
+        __m512i rows = _mm512_setzero_si512();
+        __m512i rew = _mm512_setzero_si512();
+        __m512i mer = _mm512_setzero_si512();
+        __m512i chg = _mm512_setzero_si512();
+        gatherRow<0>(t, offset, rows, rew, mer, chg);
+        gatherRow<16>(t, offset, rows, rew, mer, chg);
+        gatherRow<32>(t, offset, rows, rew, mer, chg);
+        gatherRow<48>(t, offset, rows, rew, mer, chg);
+
+        _mm512_storeu_si512(out + i, _mm512_mask_blend_epi64(vertical, rows, transposeLanes(rows)));
+        _mm512_storeu_si512(reward + i, _mm512_add_epi64(_mm512_loadu_si512(reward + i), rew));
+        _mm512_storeu_si512(merges + i, _mm512_add_epi64(_mm512_loadu_si512(merges + i), mer));
+        _mm512_storeu_si512(changed + i, _mm512_or_si512(_mm512_loadu_si512(changed + i), chg));
+    }
+#elif defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i*) (in + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*) (dirs + i));
+        // Up and down work on the transposed board, down and right use the right table
+        __m256i vertical = _mm256_cmpgt_epi64(_mm256_set1_epi64x(2), d);
+        __m256i right = _mm256_or_si256(_mm256_cmpeq_epi64(d, _mm256_set1_epi64x(1)),
+                                        _mm256_cmpeq_epi64(d, _mm256_set1_epi64x(2)));
+        __m256i offset = _mm256_and_si256(right, _mm256_set1_epi64x(65536));
+        __m256i t = _mm256_blendv_epi8(b, transposeLanes(b), vertical);
+
+        __m256i rows = _mm256_setzero_si256();
+        __m256i rew = _mm256_setzero_si256();
+        __m256i mer = _mm256_setzero_si256();
+        __m256i chg = _mm256_setzero_si256();
+        gatherRow<0>(t, offset, rows, rew, mer, chg);
+        gatherRow<16>(t, offset, rows, rew, mer, chg);
+        gatherRow<32>(t, offset, rows, rew, mer, chg);
+        gatherRow<48>(t, offset, rows, rew, mer, chg);
+
+        __m256i* outVec = (__m256i*) (out + i);
+        __m256i* rewardVec = (__m256i*) (reward + i);
+        __m256i* mergesVec = (__m256i*) (merges + i);
+        __m256i* changedVec = (__m256i*) (changed + i);
+        _mm256_storeu_si256(outVec, _mm256_blendv_epi8(rows, transposeLanes(rows), vertical));
+        _mm256_storeu_si256(rewardVec, _mm256_add_epi64(_mm256_loadu_si256(rewardVec), rew));
+        _mm256_storeu_si256(mergesVec, _mm256_add_epi64(_mm256_loadu_si256(mergesVec), mer));
+        _mm256_storeu_si256(changedVec, _mm256_or_si256(_mm256_loadu_si256(changedVec), chg));
+    }
+#endif
+    for (; i < n; i++) {
+        BoardMove moved = moveBoard(in[i], dirs[i]);
+        out[i] = moved.board;
+        reward[i] += moved.reward;
+        merges[i] += moved.merges;
+        changed[i] |= moved.changed;
+    }
+}
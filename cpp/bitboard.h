@@ -0,0 +1,128 @@
+// bitboard.h
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// A 4x4 board packed into 64 bits, one 4-bit exponent per cell (0 = empty,
+// k = tile 2^k). Cell i (row-major) lives in bits [60 - 4i, 63 - 4i], so row 0
+// is the top 16 bits and column 0 is the high nibble of each row.
+typedef uint64_t Board;
+
+const Board ROW_MASK = 0xFFFFULL;
+const Board NIBBLE_ONES = 0x1111111111111111ULL;
+
+// Result of sliding one 16-bit row: the moved row, the score gained by its
+// merges, how many merges happened and whether anything moved at all.
+struct RowMove {
+    uint16_t row;
+    uint8_t merges;
+    uint8_t changed;
+    uint32_t reward;
+};
+
+// Result of sliding a whole board, the sum of its four row moves
+struct BoardMove {
+    Board board;
+    int reward;
+    int merges;
+    bool changed;
+};
+
+// Row lookup tables, indexed by the 16-bit row value. [0] slides tiles towards
+// column 0 ("left"), [1] towards column 3 ("right", the low nibble). They share
+// one array so SIMD code can choose the table per lane with an index offset.
+extern RowMove rowMoveTables[2][65536];
+inline RowMove* const rowLeftTable = rowMoveTables[0];
+inline RowMove* const rowRightTable = rowMoveTables[1];
+
+// Swap rows and columns so that up/down moves can reuse the row tables.
+inline Board transpose(Board x) {
+    Board a1 = x & 0xF0F00F0FF0F00F0FULL;
+    Board a2 = x & 0x0000F0F00000F0F0ULL;
+    Board a3 = x & 0x0F0F00000F0F0000ULL;
+    Board a = a1 | (a2 << 12) | (a3 >> 12);
+    Board b1 = a & 0xFF00FF0000FF00FFULL;
+    Board b2 = a & 0x00FF00FF00000000ULL;
+    Board b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+// One bit (the low bit of the nibble) set for every non-empty cell
+inline Board tileMask(Board b) {
+    b |= b >> 1;
+    b |= b >> 2;
+    return b & NIBBLE_ONES;
+}
+
+inline int countTiles(Board b) { return __builtin_popcountll(tileMask(b)); }
+inline int countEmpty(Board b) { return 16 - countTiles(b); }
+
+inline int getCell(Board b, int i) { return (b >> (60 - 4 * i)) & 0xF; }
+inline Board setCell(Board b, int i, int exponent) {
+    int shift = 60 - 4 * i;
+    return (b & ~(0xFULL << shift)) | ((Board) exponent << shift);
+}
+
+inline BoardMove applyRows(Board b, const RowMove* table) {
+    const RowMove& r0 = table[b & ROW_MASK];
+    const RowMove& r1 = table[(b >> 16) & ROW_MASK];
+    const RowMove& r2 = table[(b >> 32) & ROW_MASK];
+    const RowMove& r3 = table[(b >> 48) & ROW_MASK];
+
+    BoardMove result;
+    result.board = (Board) r0.row | ((Board) r1.row << 16) |
+                   ((Board) r2.row << 32) | ((Board) r3.row << 48);
+    result.reward = r0.reward + r1.reward + r2.reward + r3.reward;
+    result.merges = r0.merges + r1.merges + r2.merges + r3.merges;
+    result.changed = r0.changed | r1.changed | r2.changed | r3.changed;
+    return result;
+}
+
+// Slide a board without spawning. 0=Up, 1=Down, 2=Right, 3=Left
+inline BoardMove moveBoard(Board b, int direction) {
+    BoardMove result;
+    switch (direction) {
+        case 0:
+            result = applyRows(transpose(b), rowLeftTable);
+            result.board = transpose(result.board);
+            return result;
+        case 1:
+            result = applyRows(transpose(b), rowRightTable);
+            result.board = transpose(result.board);
+            return result;
+        case 2: return applyRows(b, rowRightTable);
+        default: return applyRows(b, rowLeftTable);
+    }
+}
+
+// Legal-move mask in one pass: bit d is set when direction d changes the
+// board (0=Up, 1=Down, 2=Right, 3=Left). A direction is legal when some tile
+// has an empty neighbour on that side, or when two equal tiles are adjacent
+// along its axis (two 2^15 tiles never merge). A mask of 0 means the game is over.
+inline int legalMoves(Board b) {
+    const Board rowInner = 0x0111011101110111ULL;  // nibbles with a right-hand neighbour
+    const Board upperRows = 0x0000111111111111ULL; // nibbles with a neighbour below
+
+    Board tiles = tileMask(b);
+    Board empty = ~tiles & NIBBLE_ONES;
+    Board mergeable = tiles & ~(b & (b >> 1) & (b >> 2) & (b >> 3));
+    Board equalH = ~tileMask(b ^ (b >> 4)) & mergeable & rowInner;
+    Board equalV = ~tileMask(b ^ (b >> 16)) & mergeable & upperRows;
+
+    Board up = ((tiles << 16) & empty) | equalV;
+    Board down = ((tiles >> 16) & empty) | equalV;
+    Board right = ((tiles >> 4) & empty & rowInner) | equalH;
+    Board left = ((tiles << 4) & empty & (rowInner << 4)) | equalH;
+
+    return (up != 0) | ((down != 0) << 1) | ((right != 0) << 2) | ((left != 0) << 3);
+}
+
+// Slide in[i] in direction dirs[i] into out[i] for n boards, adding each
+// move's reward and merges and or-ing its changed flag into the lane
+// accumulators. in and out may alias.
+void slideLanes(const Board* in, const int64_t* dirs, Board* out,
+                int64_t* reward, int64_t* merges, int64_t* changed, int n);
+
+// Conversions between packed boards and the 16-tile vectors used for printing
+Board encodeBoard(const std::vector<int>& tiles);
+std::vector<int> decodeBoard(Board b);
@@ -0,0 +1,181 @@
+// board_state.h
+#pragma once
+#include "bitboard.h"
+#include "rng.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Value types for rollouts and tree descents. Both are trivially copyable and
+// live on the stack, so copying a position and playing it out never touches
+// the heap.
+
+const int MAX_BOARDS = 64;
+
+// A single board
+struct BoardState {
+    Board board;
+};
+
+// All boards of a multi-board game, stored contiguously
+struct BoardSet {
+    int numBoards;
+    Board boards[MAX_BOARDS];
+
+    Board& operator[](int i) { return boards[i]; }
+    const Board& operator[](int i) const { return boards[i]; }
+    Board* begin() { return boards; }
+    Board* end() { return boards + numBoards; }
+    const Board* begin() const { return boards; }
+    const Board* end() const { return boards + numBoards; }
+};
+
+// Lowest bit of mask with its k lowest set bits cleared
+inline Board nthSetBit(Board mask, int k) {
+#ifdef __BMI2__
+    return _pdep_u64(1ULL << k, mask);
+#else
+    for (; k > 0; k--) mask &= mask - 1;
+    return mask & -mask;
+#endif
+}
+
+// Outcome of one move, summed over every board
+struct StepResult {
+    bool gameOver;
+    bool changed;
+    int reward;
+    int merges;
+};
+
+// Place a 2 (90%) or a 4 (10%) on a random empty cell. One random word
+// decides both: the high half picks the k-th empty cell, the low half the value.
+inline void spawnTile(Board& board, Rng& rng) {
+    Board empty = ~tileMask(board) & NIBBLE_ONES;
+    int numEmpty = __builtin_popcountll(empty);
+    if (numEmpty == 0) return;
+
+    uint64_t r = rng.next();
+    int k = ((r >> 32) * numEmpty) >> 32;
+    // 429496730 / 2^32 is 0.1
+    Board value = ((uint32_t) r < 429496730u) ? 2 : 1;
+    board |= nthSetBit(empty, k) * value;
+}
+
+// A board with an empty cell is never over, as in the original game, so only
+// full boards need the legal-move test
+inline bool isTerminal(Board board) {
+    if (tileMask(board) != NIBBLE_ONES) return false;
+    return legalMoves(board) == 0;
+}
+inline bool isTerminal(const BoardState& state) { return isTerminal(state.board); }
+inline bool isTerminal(const BoardSet& set) {
+    for (Board board : set) {
+        if (isTerminal(board)) return true;
+    }
+    return false;
+}
+
+// Legal-move masks, see legalMoves(Board) in bitboard.h
+inline int legalMoves(const BoardState& state) { return legalMoves(state.board); }
+// A move is legal for a set when it changes at least one board. Stops at the
+// first boards that together allow every move.
+const int ALL_MOVES = 0xF;
+inline int legalMoves(const BoardSet& set) {
+    int mask = 0;
+    for (int b = 0; b < set.numBoards && mask != ALL_MOVES; b++) mask |= legalMoves(set[b]);
+    return mask;
+}
+
+// Uniformly random direction among the set bits of a non-empty mask
+inline int randomMove(int mask, Rng& rng) {
+    int take = rng.nextBelow(__builtin_popcount(mask));
+    for (; take > 0; take--) mask &= mask - 1;
+    return __builtin_ctz(mask);
+}
+
+// Sets with at least this many boards slide in one SIMD pass, see slideBoards
+const int SIMD_MIN_BOARDS = 8;
+
+// Slide every board of set in direction into out, which may alias set's
+// boards, in one pass of slideLanes over the contiguous array
+inline StepResult slideBoards(const BoardSet& set, int direction, Board* out) {
+    int n = set.numBoards;
+    int64_t dirs[MAX_BOARDS] = {}, reward[MAX_BOARDS] = {}, merges[MAX_BOARDS] = {}, changed[MAX_BOARDS] = {};
+    for (int b = 0; b < n; b++) dirs[b] = direction;
+    slideLanes(set.boards, dirs, out, reward, merges, changed, n);
+
+    StepResult result = {false, false, 0, 0};
+    for (int b = 0; b < n; b++) {
+        result.changed |= changed[b] != 0;
+        result.reward += reward[b];
+        result.merges += merges[b];
+    }
+    return result;
+}
+
+// Reward, merges and changed flag of a move, without applying it
+inline StepResult evaluateMove(Board board, int direction) {
+    BoardMove moved = moveBoard(board, direction);
+    return {false, moved.changed, moved.reward, moved.merges};
+}
+inline StepResult evaluateMove(const BoardState& state, int direction) {
+    return evaluateMove(state.board, direction);
+}
+inline StepResult evaluateMove(const BoardSet& set, int direction) {
+    if (set.numBoards >= SIMD_MIN_BOARDS) {
+        Board moved[MAX_BOARDS];
+        return slideBoards(set, direction, moved);
+    }
+    StepResult result = {false, false, 0, 0};
+    for (Board board : set) {
+        BoardMove moved = moveBoard(board, direction);
+        result.changed |= moved.changed;
+        result.reward += moved.reward;
+        result.merges += moved.merges;
+    }
+    return result;
+}
+
+// Slide every board without spawning
+inline StepResult slide(BoardState& state, int direction) {
+    BoardMove moved = moveBoard(state.board, direction);
+    state.board = moved.board;
+    return {false, moved.changed, moved.reward, moved.merges};
+}
+inline StepResult slide(BoardSet& set, int direction) {
+    if (set.numBoards >= SIMD_MIN_BOARDS) return slideBoards(set, direction, set.boards);
+    StepResult result = {false, false, 0, 0};
+    for (Board& board : set) {
+        BoardMove moved = moveBoard(board, direction);
+        result.changed |= moved.changed;
+        result.reward += moved.reward;
+        result.merges += moved.merges;
+        board = moved.board;
+    }
+    return result;
+}
+
+// Slide, then spawn a tile on every board if anything moved. The game is over
+// as soon as one board has no moves left.
+inline StepResult step(BoardState& state, int direction, Rng& rng) {
+    StepResult result = slide(state, direction);
+    if (result.changed) {
+        spawnTile(state.board, rng);
+        result.gameOver = isTerminal(state.board);
+    }
+    return result;
+}
+inline StepResult step(BoardSet& set, int direction, Rng& rng) {
+    StepResult result = slide(set, direction);
+    if (result.changed) {
+        for (Board& board : set) {
+            spawnTile(board, rng);
+            if (isTerminal(board)) {
+                result.gameOver = true;
+                break;
+            }
+        }
+    }
+    return result;
+}
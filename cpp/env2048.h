@@ -1,33 +1,33 @@
 // env2048.h
 #pragma once
 #include <vector>
-#include <random>
+#include "board_state.h"
+#include "rng.h"
 
 class Game2048 {
 public:
-    Game2048(int numBoards);
-    Game2048(const Game2048& other);  // Copy constructor for MCTS
-    Game2048(std::vector<int>& board); // Constructor for pre set board
+    Game2048(int numBoards, uint64_t seed = streamSeed(STREAM_ENV));
+    // Copy constructor for MCTS. The copy continues the same spawn stream, so
+    // call reseed() on copies that must play out independently.
+    Game2048(const Game2048& other);
+    Game2048(std::vector<int>& board, uint64_t seed = streamSeed(STREAM_ENV)); // Constructor for pre set board
+    Game2048(Board board, uint64_t seed = streamSeed(STREAM_ENV)); // Constructor for a pre set packed board
 
     int numBoards;
     
-    struct MoveResult {
-        bool gameOver;
-        bool changed;
-        int reward;
-        int merges;
-    };
+    typedef StepResult MoveResult;
 
     MoveResult move(int direction);  // 0=Up, 1=Down, 2=Right, 3=Left
     MoveResult moveWithoutSpawn(int direction);
-    bool isGameOver(const std::vector<int>& board) const;
-    const std::vector<std::vector<int>>& getBoards() const { return boards; }
+    void reseed(uint64_t seed) { rng.reseed(seed); }
+    bool isGameOver(Board board) const { return isTerminal(board); }
+    // Tile values of every board, decoded from the packed representation
+    std::vector<std::vector<int>> getBoards() const;
+    // The boards as a trivially copyable value, for rollouts to copy
+    const BoardSet& getBoardSet() const { return boards; }
 
-    std::vector<std::vector<int>> boards;
+    BoardSet boards;
 
 private:
-    void genRandom(std::vector<int>& board);
-    std::vector<int> moveLine(const std::vector<int>& line, bool& moved, int& score) const;
-
-    std::mt19937 rng;
-};
\ No newline at end of file
+    Rng rng;
+};
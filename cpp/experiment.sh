@@ -7,6 +7,7 @@ MCTS_TYPE="merge"
 SIMULATIONS=500
 C_VALUE=500  # Default C value
 BOARDS=3     # Default number of boards
+SEED=""      # Base seed; experiment i runs with seed SEED+i. Random if empty.
 DATA_DIR="data_final"
 RESULTS_DIR="results_final"
 TIMESTAMP=$(date +%Y%m%d_%H%M%S)
@@ -47,6 +48,10 @@ while [[ $# -gt 0 ]]; do
             BOARDS="$2"
             shift 2
             ;;
+        --seed)
+            SEED="$2"
+            shift 2
+            ;;
         *)
             echo "Unknown parameter: $1"
             exit 1
@@ -67,6 +72,7 @@ echo "- Parallel units: $PARALLEL_RUNS"
 echo "- MCTS type: $MCTS_TYPE"
 echo "- C value: $C_VALUE"
 echo "- Number of boards: $BOARDS"
+echo "- Base seed: ${SEED:-random}"
 
 # Compile with specified MCTS type
 echo -e "\nCompiling with MCTS_TYPE=$MCTS_TYPE..."
@@ -85,7 +91,7 @@ if [[ ${USES_OPENMP[$MCTS_TYPE]} ]]; then
         
         start_time=$(date +%s%N)
         # Use OpenMP threads for internal parallelization, pass simulation count and C value
-        game_output=$(OMP_NUM_THREADS=$PARALLEL_RUNS ./game2048 $BOARDS $SIMULATIONS $C_VALUE 2>&1)
+        game_output=$(OMP_NUM_THREADS=$PARALLEL_RUNS ./game2048 $BOARDS $SIMULATIONS $C_VALUE ${SEED:+--seed $((SEED + i))} 2>&1)
         end_time=$(date +%s%N)
         duration_ms=$(( (end_time - start_time) / 1000000 ))
         
@@ -111,7 +117,7 @@ else
         
         start_time=$(date +%s%N)
         # Pass simulation count and C value to game2048
-        ./game2048 $BOARDS $SIMULATIONS $C_VALUE > "$log_file" 2>&1
+        ./game2048 $BOARDS $SIMULATIONS $C_VALUE ${SEED:+--seed $((SEED + exp_num))} > "$log_file" 2>&1
         end_time=$(date +%s%N)
         duration_ms=$(( (end_time - start_time) / 1000000 ))
         
@@ -123,7 +129,7 @@ else
         echo "Completed experiment $exp_num"
     }
     
-    export SIMULATIONS C_VALUE BOARDS  # Make available to subprocesses
+    export SIMULATIONS C_VALUE BOARDS SEED  # Make available to subprocesses
     
     # Run experiments in batches
     completed=0
@@ -0,0 +1,118 @@
+// flat_search.h
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <omp.h>
+#include "batch_rollout.h"
+#include "search_budget.h"
+#include "search_options.h"
+#include "symmetry.h"
+
+// Flat Monte Carlo shared by the random, merge and score engines: every legal
+// move is scored by the total reward of playouts that start with it.
+
+// Batches of playouts per move between two looks at the root statistics for
+// stopping early
+const int STOP_CHECK_BATCHES = 1;
+
+// Add to stats[move] the rewards of the playouts numbered first .. first +
+// count - 1 of each move in moves, run as lock-step batches of lanesPerBatch.
+// The batches of all the moves are spread over the OpenMP threads together.
+// Playout i of a move draws from search stream i of the move, and the sums
+// are exact integers, so the stats do not depend on the number of threads.
+template <class Policy>
+void flatRollouts(const BoardSet& start, int moves, int moveNumber, int first, int count, int lanesPerBatch,
+                  ActionStats stats[4]) {
+    int numBatches = (count + lanesPerBatch - 1) / lanesPerBatch;
+    int list[4];
+    int numMoves = 0;
+    for (int move = 0; move < 4; move++) {
+        if (moves & (1 << move)) list[numMoves++] = move;
+    }
+
+    long long scoreSum[4] = {0, 0, 0, 0};
+    long long squareSum[4] = {0, 0, 0, 0};
+    #pragma omp parallel for reduction(+:scoreSum[:4], squareSum[:4])
+    for (int job = 0; job < numMoves * numBatches; job++) {
+        int move = list[job / numBatches];
+        int begin = (job % numBatches) * lanesPerBatch;
+        int lanes = std::min(lanesPerBatch, count - begin);
+        uint64_t seeds[BATCH_LANES];
+        int scores[BATCH_LANES];
+        for (int lane = 0; lane < lanes; lane++) {
+            seeds[lane] = streamSeed(STREAM_SEARCH, moveNumber, move, first + begin + lane);
+        }
+        batchRollout<Policy>(start, move, seeds, lanes, scores);
+        for (int lane = 0; lane < lanes; lane++) {
+            scoreSum[move] += scores[lane];
+            squareSum[move] += (long long) scores[lane] * scores[lane];
+        }
+    }
+    for (int i = 0; i < numMoves; i++) {
+        stats[list[i]].sum += scoreSum[list[i]];
+        stats[list[i]].squares += squareSum[list[i]];
+        stats[list[i]].count += count;
+    }
+}
+
+// Set rewards[move] to the total reward of the playouts of each legal move,
+// and to -1 for illegal moves. Every legal move gets simulations playouts, or
+// as many as fit before the deadline of options.moveTimeMs. With
+// options.earlyStop, a forced move is played without playouts and the search
+// ends once the best move leads by that many standard errors; the playouts of
+// the budget left over are added to saved. With options.symmetry, a move whose
+// result mirrors that of a lower move gets a copy of its rewards instead of
+// playouts of its own, and its budget is saved too. Returns the number of
+// playouts run.
+template <class Policy>
+long long flatSearch(const BoardSet& state, int moveNumber, int simulations, const SearchOptions& options,
+                     std::vector<float>& rewards, long long& saved) {
+    int legal = legalMoves(state);
+    int numLegal = __builtin_popcount(legal);
+    ActionStats stats[4];
+    int perMove = 0;
+    bool stopEarly = options.earlyStop > 0;
+
+    // Legal moves that get playouts, and the move each takes its rewards from
+    int searched = legal;
+    int source[4] = {0, 1, 2, 3};
+    for (int move = 0; move < 4 && options.symmetry; move++) {
+        source[move] = representativeMove(state, move);
+        if (source[move] != move) searched &= ~(1 << move);
+    }
+    int numSearched = __builtin_popcount(searched);
+
+    Deadline deadline(options.moveTimeMs);
+    if (stopEarly && numLegal == 1) {
+        // Forced move, nothing to compare
+        if (!deadline.active()) saved += simulations;
+    } else if (deadline.active() || stopEarly) {
+        // Rounds in which every move gets the same number of playouts.
+        // Against a deadline, one small batch per thread for each move, so
+        // the deadline is overrun by at most one short round. Otherwise a
+        // fixed number of batches, so the search stops after the same
+        // playouts whatever the number of threads.
+        int lanesPerBatch = deadline.active() ? BATCH_LANES / 4 : BATCH_LANES;
+        int round = deadline.active() ? lanesPerBatch * omp_get_max_threads() : STOP_CHECK_BATCHES * BATCH_LANES;
+        int budget = deadline.active() ? INT_MAX : simulations;
+        while (perMove < budget && !(stopEarly && leaderSecure(stats, searched, options.earlyStop))) {
+            int count = std::min(round, budget - perMove);
+            flatRollouts<Policy>(state, searched, moveNumber, perMove, count, lanesPerBatch, stats);
+            perMove += count;
+            if (deadline.passed()) break;
+        }
+        if (!deadline.active()) saved += (long long) (simulations - perMove) * numSearched;
+    } else {
+        // Lock-step batches, keeping at least one batch per thread
+        int lanesPerBatch = std::max(1, std::min(BATCH_LANES, simulations / omp_get_max_threads()));
+        flatRollouts<Policy>(state, searched, moveNumber, 0, simulations, lanesPerBatch, stats);
+        perMove = simulations;
+    }
+    if (!deadline.active()) saved += (long long) simulations * (numLegal - numSearched);
+
+    for (int move = 0; move < 4; move++) {
+        rewards[move] = (legal & (1 << move)) ? stats[source[move]].sum : -1;
+    }
+    return (long long) perMove * numSearched;
+}
@@ -1,4 +1,9 @@
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <chrono>
 #include <iomanip>
 #ifdef _OPENMP
@@ -8,34 +13,42 @@
 #ifdef USE_RANDOM_RANDOM
 #include "random_random/mcts_random_random.h"
 typedef MCTSRandomRandom MCTSImpl;
+const char* ENGINE_NAME = "randomrandom";
 #endif
 #ifdef USE_MERGE
 #include "merge/mcts_merge.h"
 typedef MCTSMerge MCTSImpl;
+const char* ENGINE_NAME = "merge";
 #endif
 #ifdef USE_RANDOM
 #include "random/mcts_random.h"
 typedef MCTSRandom MCTSImpl;
+const char* ENGINE_NAME = "random";
 #endif
 #ifdef USE_SCORE
 #include "score/mcts_score.h"
 typedef MCTSScore MCTSImpl;
+const char* ENGINE_NAME = "score";
 #endif
 #ifdef USE_PUCT_SINGLE
 #include "pUCT/mcts_pUCT.h"
 typedef MCTSpUCT MCTSImpl;
+const char* ENGINE_NAME = "puct";
 #endif
 #ifdef USE_PUCT_MULTIPLE
 #include "pUCT_multiple/mcts_pUCT.h"
 typedef MCTSpUCT MCTSImpl;
+const char* ENGINE_NAME = "puctmult";
 #endif
 #ifdef USE_PUCT_MIN_MULTIPLE
 #include "pUCT_min_multiple/mcts_pUCT.h"
 typedef MCTSpUCT MCTSImpl;
+const char* ENGINE_NAME = "puctminmult";
 #endif
 #ifdef USE_PUCT_COMB_MULTIPLE
 #include "pUCT_comb_multiple/mcts_pUCT.h"
 typedef MCTSpUCT MCTSImpl;
+const char* ENGINE_NAME = "puctcombmult";
 #endif
 
 using namespace std::chrono;
@@ -45,21 +58,28 @@ struct GameStats {
     int final_score;
     double total_time;
     double avg_time_per_move;
+    long long simulations;  // Run by the search over the whole game
+    long long saved;        // Left unspent by early stopping
+    std::vector<int> moves;
 };
 
-GameStats run_game(int num_boards, int num_simulations, double c_param) {
-    MCTSImpl mcts(num_boards, num_simulations, c_param);
-    GameStats stats = {0, 0, 0.0, 0.0};
+GameStats run_game(int num_boards, int num_simulations, double c_param, const SearchOptions& options) {
+    MCTSImpl mcts(num_boards, num_simulations, c_param, options);
+    GameStats stats = {0, 0, 0.0, 0.0, 0, 0, {}};
     auto start_time = high_resolution_clock::now();
     
     while (!mcts.makeMove()) {
         stats.total_moves++;
+        stats.moves.push_back(mcts.getLastMove());
     }
+    stats.moves.push_back(mcts.getLastMove());
     
     auto end_time = high_resolution_clock::now();
     stats.total_time = duration<double>(end_time - start_time).count();
     stats.avg_time_per_move = stats.total_time / stats.total_moves;
     stats.final_score = mcts.getPoints();
+    stats.simulations = mcts.getSimulations();
+    stats.saved = mcts.getSimulationsSaved();
     
     return stats;
 }
@@ -71,20 +91,167 @@ void print_stats(const GameStats& stats) {
     std::cout << std::fixed << std::setprecision(3);
     std::cout << "Total time: " << stats.total_time << " seconds\n";
     std::cout << "Average time per move: " << stats.avg_time_per_move * 1000 << " ms\n";
+    std::cout << "Average simulations per move: " << (double) stats.simulations / stats.total_moves << "\n";
+    std::cout << "Average simulations saved per move: " << (double) stats.saved / stats.total_moves << "\n";
     std::cout << "Moves per second: " << stats.total_moves / stats.total_time << "\n";
 }
 
+// A recording holds everything needed to re-run a game: the engine (its
+// MCTS_TYPE in the makefile) with all its settings, and the master seed that
+// fixes every spawn and rollout. The moves it played are kept to check a
+// replay against.
+void write_recording(const char* path, uint64_t seed, int num_boards, int num_simulations,
+                     double c_param, const SearchOptions& options, const GameStats& stats) {
+    std::ofstream out(path);
+    out << std::setprecision(17);
+    out << "engine " << ENGINE_NAME << "\n";
+    out << "seed " << seed << "\n";
+    out << "boards " << num_boards << "\n";
+    out << "simulations " << num_simulations << "\n";
+    out << "c " << c_param << "\n";
+    out << "leaf_rollouts " << options.leafRollouts << "\n";
+    out << "reuse " << options.reuseTree << "\n";
+    out << "transpositions " << options.transpositions << "\n";
+    out << "threads " << options.threads << "\n";
+    out << "ensemble " << options.ensemble << "\n";
+    out << "move_time_ms " << options.moveTimeMs << "\n";
+    out << "early_stop " << options.earlyStop << "\n";
+    out << "max_outcomes " << options.maxOutcomes << "\n";
+    out << "symmetry " << options.symmetry << "\n";
+    out << "score " << stats.final_score << "\n";
+    out << "moves";
+    for (int move : stats.moves) out << " " << move;
+    out << "\n";
+}
+
+// Play a recorded game again with the engine and settings it was recorded
+// with, and check that the search chooses every move it chose then. Reports
+// the same statistics as a normal run, so a recording doubles as a benchmark.
+int replay_game(const char* path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open recording " << path << "\n";
+        return 1;
+    }
+
+    std::string engine;
+    uint64_t seed = 0;
+    int num_boards = 1;
+    int num_simulations = 250;
+    double c_param = 600.0;
+    SearchOptions options;
+    int recorded_score = -1;
+    std::vector<int> moves;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "engine") fields >> engine;
+        else if (key == "seed") fields >> seed;
+        else if (key == "boards") fields >> num_boards;
+        else if (key == "simulations") fields >> num_simulations;
+        else if (key == "c") fields >> c_param;
+        else if (key == "leaf_rollouts") fields >> options.leafRollouts;
+        else if (key == "reuse") fields >> options.reuseTree;
+        else if (key == "transpositions") fields >> options.transpositions;
+        else if (key == "threads") fields >> options.threads;
+        else if (key == "ensemble") fields >> options.ensemble;
+        else if (key == "move_time_ms") fields >> options.moveTimeMs;
+        else if (key == "early_stop") fields >> options.earlyStop;
+        else if (key == "max_outcomes") fields >> options.maxOutcomes;
+        else if (key == "symmetry") fields >> options.symmetry;
+        else if (key == "score") fields >> recorded_score;
+        else if (key == "moves") {
+            int move;
+            while (fields >> move) moves.push_back(move);
+        }
+    }
+
+    if (engine.empty()) {
+        std::cerr << "Recording " << path << " names no engine\n";
+        return 1;
+    }
+    if (engine != ENGINE_NAME) {
+        std::cerr << "Recording was made with engine '" << engine << "', this binary is '"
+                  << ENGINE_NAME << "' (build with MCTS_TYPE=" << engine << ")\n";
+        return 1;
+    }
+    if (num_boards < 1 || num_boards > MAX_BOARDS) {
+        std::cerr << "Recording has " << num_boards << " boards\n";
+        return 1;
+    }
+
+    std::cout << "Replaying " << moves.size() << " moves with engine " << engine << ", seed " << seed << "\n";
+    if (options.moveTimeMs > 0 || options.threads > 1) {
+        std::cout << "Recorded with a time budget or several threads: the search need not repeat its moves\n";
+    }
+
+    setMasterSeed(seed);
+    GameStats stats = run_game(num_boards, num_simulations, c_param, options);
+    print_stats(stats);
+
+    size_t same = 0;
+    while (same < moves.size() && same < stats.moves.size() && moves[same] == stats.moves[same]) same++;
+    if (same < moves.size() || same < stats.moves.size()) {
+        std::cout << "Replay leaves the recording at move " << same + 1 << " of " << moves.size() << "\n";
+        return 1;
+    }
+    if (stats.final_score != recorded_score) {
+        std::cout << "Replay does not match the recording (recorded score " << recorded_score << ")\n";
+        return 1;
+    }
+    std::cout << "Replay matches the recording\n";
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     int num_boards = 1;
     int num_simulations = 250;
     double c_param = 600.0;  // Default C value
+    uint64_t seed = masterSeed();  // Random unless --seed is given
+    const char* record_path = nullptr;
+    SearchOptions options;
+
+    // Usage: game2048 [num_boards] [num_simulations] [c_param] [leaf_rollouts]
+    //                 [--seed N] [--record FILE] [--no-reuse] [--transpositions N]
+    //                 [--threads N] [--ensemble N] [--move-time-ms MS] [--early-stop Z]
+    //                 [--max-outcomes N] [--symmetry]
+    //        game2048 --replay FILE
+    std::vector<char*> positional;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--record" && i + 1 < argc) record_path = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) return replay_game(argv[++i]);
+        else if (arg == "--no-reuse") options.reuseTree = false;
+        else if (arg == "--transpositions" && i + 1 < argc) options.transpositions = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && i + 1 < argc) options.threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--ensemble" && i + 1 < argc) options.ensemble = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--move-time-ms" && i + 1 < argc) options.moveTimeMs = std::atof(argv[++i]);
+        else if (arg == "--early-stop" && i + 1 < argc) options.earlyStop = std::atof(argv[++i]);
+        else if (arg == "--max-outcomes" && i + 1 < argc) options.maxOutcomes = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--symmetry") options.symmetry = true;
+        else positional.push_back(argv[i]);
+    }
+
+    if (positional.size() > 0) num_boards = std::atoi(positional[0]);
+    if (positional.size() > 1) num_simulations = std::atoi(positional[1]);
+    if (positional.size() > 2) c_param = std::atof(positional[2]);
+    if (positional.size() > 3) options.leafRollouts = std::max(1, std::atoi(positional[3]));
+
+    if (num_boards < 1 || num_boards > MAX_BOARDS) {
+        std::cerr << "Number of boards must be between 1 and " << MAX_BOARDS << "\n";
+        return 1;
+    }
 
-    if (argc > 1) num_boards = std::atoi(argv[1]);
-    if (argc > 2) num_simulations = std::atoi(argv[2]);
-    if (argc > 3) c_param = std::atof(argv[3]);
+    // Every spawn and rollout is derived from this seed, independent of thread count
+    setMasterSeed(seed);
 
-    std::cout << "Running with " << num_boards << " boards and " 
-              << num_simulations << " simulations per move\n";
+    std::cout << "Running with " << num_boards << " boards and ";
+    if (options.moveTimeMs > 0) std::cout << options.moveTimeMs << " ms per move\n";
+    else std::cout << num_simulations << " simulations per move\n";
+    std::cout << "Seed: " << seed << "\n";
     
     #ifdef USE_RANDOM_RANDOM
     std::cout << "Using Random-Random MC\n";
@@ -115,7 +282,8 @@ int main(int argc, char* argv[]) {
     std::cout << "OpenMP threads: " << omp_get_max_threads() << "\n";
     #endif
     
-    auto stats = run_game(num_boards, num_simulations, c_param);
+    auto stats = run_game(num_boards, num_simulations, c_param, options);
     print_stats(stats);
+    if (record_path) write_recording(record_path, seed, num_boards, num_simulations, c_param, options, stats);
     return 0;
 }
\ No newline at end of file
@@ -1,17 +1,25 @@
 // mcts_random.h
 #pragma once
 #include "env2048.h"
+#include "search_options.h"
 
 class MCTSMerge {
 public:
-    MCTSMerge(int n, int simulations, double c_param=800);
+    MCTSMerge(int n, int simulations, double c_param=800, const SearchOptions& options = SearchOptions());
     bool makeMove();  // Returns true if game is over
     int getPoints() const { return points; }
+    int getLastMove() const { return lastMove; }
+    long long getSimulations() const { return simulationsRun; }
+    long long getSimulationsSaved() const { return simulationsSaved; }
     const Game2048& getGame() const { return game; }
 
 private:
-    int moveToEnd(int move);
     Game2048 game;
     int simulations;
     int points;
+    int moveNumber;
+    int lastMove;
+    long long simulationsRun;
+    long long simulationsSaved;  // Budget left unspent by stopping early
+    SearchOptions options;
 };
\ No newline at end of file
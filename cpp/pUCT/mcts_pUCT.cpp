@@ -1,19 +1,22 @@
 // mcts_pUCT.cpp
 #include "mcts_pUCT.h"
-#include <random>
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <iomanip>
 #include <cassert>
+#include <cmath>
 
 // pUCT for single games
 
-MCTSpUCT::MCTSpUCT(int n, int simulations, double c_param) 
-    : C(c_param), game(n), simulations(4 * simulations), points(0), acquired(0) {
+MCTSpUCT::MCTSpUCT(int n, int simulations, double c_param, const SearchOptions& options) 
+    : C(c_param), game(n), simulations(4 * simulations), points(0), moveNumber(0), lastMove(-1), rootSymmetry(0), simulationsRun(0), simulationsSaved(0), options(options), trees(new SearchTree<Board>[options.ensemble]) {
     // Enable nested parallelism
     omp_set_nested(1);
+    for(int k = 0; k < options.ensemble; k++)  {
+        trees[k].setTranspositions(options.transpositions);
+    }
 }
 
 struct MoveResult {
@@ -22,274 +25,86 @@ struct MoveResult {
     bool validMove = false;
 };
 
-pUCTNode::pUCTNode(unsigned long state, bool chance, int a)
-    : value(0), visits(0), chance(chance), state(state)  {
-        if(chance)  {
-            action = a;
-        } else  {
-            action = -1;
-        }
-    }
-
-void pUCTNode::incrementVisits()  { visits++; }
-void pUCTNode::increaseValue(double v) { value += v; }
-
-// Merge policy
-int MCTSpUCT::moveToEnd(Game2048* currGame) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(*currGame);
-    
-    int score = 0;
-    Game2048::MoveResult result;
-    result.gameOver = false;
-
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-    
-    // Then do moves that maximize the merges until game over
-    while (!result.gameOver) {
-        // Test each possible move
-        std::vector<double> merges(4);
-        double sum = 0;
-        for (int move = 0; move < 4; move++) {
-            // Test if move is valid using a temporary copy
-            Game2048 testGame(gameCopy);
-            auto moveResult = testGame.moveWithoutSpawn(move);
-            
-            if (!moveResult.changed) {
-                continue;
-            }
-            
-            merges[move] = exp(moveResult.merges);
-            sum += merges[move];
-        }
-
-        for (int move = 0; move < 4; move++)  {
-            merges[move] /= sum;
-        }
-
-        double val = dis(gen);
-        int nextMove = 0;
-        double cp = 0.0;
-        for (int move = 0; move < 4; move++)  {
-            cp += merges[move];
-            if(val < cp)  {
-                nextMove = move;
-                break;
-            }
-        }
-
-        result = gameCopy.move(nextMove);
-        score += result.reward;
-    }
-    
-    return score;
-}
-
-// Random policy. Random is much faster than merge but performs worse.
-// int MCTSpUCT::moveToEnd(Game2048* currGame) {
-//     // Create a fresh copy for this simulation
-//     Game2048 gameCopy(*currGame);
-    
-//     // Then do random moves until game over
-//     std::mt19937 gen(std::random_device{}());
-//     std::uniform_int_distribution<> dis(0, 3);
-
-//     // First apply the move we're testing
-//     auto result = gameCopy.move(dis(gen));
-//     int score = result.reward;
-
-//     int moves = 0;
-    
-//     while (!result.gameOver) {
-//         result = gameCopy.move(dis(gen));
-//         score += result.reward;
-//         ++moves;
-//     }
-
-//     //for(auto board : gameCopy.getBoards())  {
-//     //    for(int i = 0; i < 16; i++)  {
-//     //        score += board[i];
-//     //    }
-//     //}
-    
-//     return score;
-// }
-
-// Get an unsigned long corresponding to current state for the tree
-unsigned long MCTSpUCT::getBoardNum(Game2048* currGame)  {
-    unsigned long val = 0;
-    // Note: SHOULD ONLY USE ONE BOARD
-    for(auto board : currGame->getBoards())  {
-        for(int i = 0; i < 16; i++)  {
-            val <<= 4;
-
-            unsigned long log = 0;
-            unsigned long tile = board[i];
-
-            while(tile > 0)  {
-                ++log;
-                tile /= 2;
-            }
-            val += log;
-        }
-    }
-
-    return val;
-}
-
-// Select an action
-int MCTSpUCT::selectAction(pUCTNode* node)  {
-    // If we haven't explored all moves, pick one of them randomly
-    if(node->children.size() != 4)  {
-        std::mt19937 gen(std::random_device{}());
-        std::uniform_int_distribution<> dis(0, 3 - node->children.size());
-        int take = dis(gen);
-
-        std::vector<bool> exist(4);
-        for(auto child : node->children)  {
-            exist[child->action] = true;
-        }
-
-        int index = 0;
-        for(int i = 0; i < 4; i++)  {
-            if(exist[i]) continue;
-
-            if(take == index)  {
-                return i;
-            }
-            ++index;
-        }
-
-        return -1;
-    } else  {
-        double bestUCB = -1;
-        int a = -1;
-
-        for(auto child : node->children)  {
-            double ucb = child->value / child->visits + C * sqrt(log(node->visits) / child->visits);
-            //std::cout << "UCB " << ucb << "\n";
-            if(ucb > bestUCB)  {
-                bestUCB = ucb;
-                a = child->action;
-            }
-        }
-
-        return a;
-    }
-}
-
-// Sample for pUCT
-double MCTSpUCT::sample(pUCTNode* node, Game2048* currGame)  {
-    double before = node->value;
-
-    if(node->chance)  {
-        int acq = acquired;
-        auto children = node->children;
-        unsigned long state = getBoardNum(currGame);
-        pUCTNode* curr = nullptr;
-
-        for(auto child : children)  {
-            if(child->state == state)  {
-                curr = child;
-                break;
-            }
-        }
-
-        if(!curr)  {
-            curr = new pUCTNode(state, false, -1);
-            node->children.push_back(curr);
-        }
-
-        node->value += sample(curr, currGame) + acq;
-    } else if(node->visits == 0.0)  {
-        node->value = moveToEnd(currGame);
-    } else  {
-        int a = selectAction(node);
-        
-        pUCTNode* curr = nullptr;
-        auto children = node->children;
-
-        for(auto child : children)  {
-            if(child->action == a)  {
-                curr = child;
-                break;
-            }
-        }
-        if(!curr)  {
-            curr = new pUCTNode(0, true, a);
-            node->children.push_back(curr);
-        }
-        auto result = currGame->move(a);
-
-        acquired = result.reward;
-
-        if(result.gameOver)  {
-            curr->visits++;
-        } else  {
-            node->value += sample(curr, currGame);
-        }
-
-        // Make sure we never make that move again since it did nothing.
-        if(!result.changed)  {
-            curr->visits = 100000000;
-        }
-    }
-
-    node->visits += 1;
-
-    return node->value - before;
-}
-
-// Clear the Tree
-void MCTSpUCT::clearTree(pUCTNode* node, bool skipDelete)  {
-    if(!node->children.empty())  {
-        for(auto child : node->children)  {
-            clearTree(child, false);
-        }
-    }
-
-    if(!skipDelete)  {
-        delete node;
-    }
-}
-
 bool MCTSpUCT::makeMove() {
     std::vector<float> rewards(4);
 
-    // Start the tree
-    pUCTNode node(getBoardNum(&game), false, -1);
-
-    // pUCT
-    for(int sim = 0; sim < simulations; sim++)  {
-        Game2048 copyGame(game);
-
-        sample(&node, &copyGame);
+    // With symmetry, the trees hold every position in its canonical
+    // orientation, and moves at the root are mapped to and from it.
+    Deadline deadline(options.moveTimeMs);
+    BoardSet rootState = game.getBoardSet();
+    int symmetry = options.symmetry ? canonicalSymmetry(rootState) : 0;
+    applySymmetry(rootState, symmetry);
+    for(int k = 0; k < options.ensemble; k++)  {
+        trees[k].advanceOrClear(options.reuseTree && lastMove >= 0, applySymmetry(lastMove, rootSymmetry), positionKey(rootState, 0));
     }
+    rootSymmetry = symmetry;
+
+    // With early stopping, a forced move is played without searching
+    int legal = legalMoves(game.getBoardSet());
+    int rootLegal = legalMoves(rootState);
+    bool stopEarly = options.earlyStop > 0;
+    bool forced = stopEarly && __builtin_popcount(legal) == 1;
+
+    // Root parallelization: the trees of the ensemble search independently,
+    // each with its share of the budget and its own random streams
+    long long run = 0;
+    long long saved = 0;
+    #pragma omp parallel for schedule(dynamic) if(options.ensemble > 1) reduction(+:run, saved)
+    for(int k = 0; k < options.ensemble; k++)  {
+        PuctTree<Board>& tree = trees[k].tree();
+        // Continue from the subtree kept from the last move, if any
+        NodeIndex root = trees[k].getRoot();
+        int budget = simulations / options.ensemble + (k < simulations % options.ensemble);
+        int first = tree.decision(root).visits;
+        int count = 0;
+
+        // pUCT. With more than one thread they search the tree together, and the
+        // result depends on how their simulations interleave. Each tree of the
+        // ensemble stops early on its own root statistics.
+        if(!forced)  {
+            count = runSimulations(first, budget, deadline, stopEarly, options.threads, [&](int sim)  {
+                BoardSet copyState = rootState;
+                Rng rng(streamSeed(STREAM_SEARCH, moveNumber, k, sim));
+
+                simulate<RolloutPolicy>(tree, root, copyState, C, options.leafRollouts, rng,
+                    [&](ChanceNode& chance, BoardSet& state)  {
+                        if(options.symmetry)  applySymmetry(state, canonicalSymmetry(state));
+                        return tree.outcomeChild(chance, positionKey(state, 0));
+                    });
+            }, [&]()  {
+                ActionStats stats[4];
+                addChildStats(tree, tree.decision(root), stats);
+                return leaderSecure(stats, rootLegal, options.earlyStop);
+            });
+        }
+        run += count;
+        if(!deadline.active())  saved += std::max(0, budget - first - count);
+    }
+    simulationsRun += run;
+    simulationsSaved += saved;
 
+    // Merge the root statistics of the ensemble
     std::vector<double> valuevalue(4);
     std::vector<double> visitsvisits(4);
     for(int move = 0; move < 4; move++)  {
-        Game2048 testGame(game);
-        auto moveResult = testGame.moveWithoutSpawn(move);
-        
-        if (!moveResult.changed) {
+        if (!(legal & (1 << move))) {
             rewards[move] = -1;
             continue;
         }
 
-        for(auto child : node.children)  {
-            if(child->action == move)  {
-                rewards[move] = (float) child->value / child->visits;
-                valuevalue[move] = child->value;
-                visitsvisits[move] = child->visits;
-                break;
+        for(int k = 0; k < options.ensemble; k++)  {
+            PuctTree<Board>& tree = trees[k].tree();
+            NodeIndex child = tree.decision(trees[k].getRoot()).children[applySymmetry(move, rootSymmetry)];
+            if(child != NO_NODE)  {
+                ChanceNode& node = tree.chance(child);
+                valuevalue[move] += node.value;
+                visitsvisits[move] += node.visits;
             }
         }
+        if(visitsvisits[move] > 0)  {
+            rewards[move] = valuevalue[move] / visitsvisits[move];
+        }
     }
-
-    // Free the memory
-    clearTree(&node, true);
     
     // Find best move
     int bestMove = 0;
@@ -305,7 +120,9 @@ bool MCTSpUCT::makeMove() {
     // Make the actual move
     auto result = game.move(bestMove);
     points += result.reward;
-    
+    lastMove = bestMove;
+    moveNumber++;
+
     if (result.gameOver) {
         std::cout << "Game over! Total points: " << points << std::endl;
         std::cout << "Final board state:" << std::endl;
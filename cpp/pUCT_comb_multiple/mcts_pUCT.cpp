@@ -1,17 +1,17 @@
 // mcts_pUCT.cpp
 #include "mcts_pUCT.h"
-#include <random>
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <iomanip>
 #include <cassert>
+#include <cmath>
 
 // Oblivious pUCT
 
-MCTSpUCT::MCTSpUCT(int n, int simulations, double C) 
-    : game(n), simulations(4*simulations), points(0), C(C) {
+MCTSpUCT::MCTSpUCT(int n, int simulations, double C, const SearchOptions& options) 
+    : game(n), simulations(4*simulations), points(0), C(C), moveNumber(0), lastMove(-1), simulationsRun(0), simulationsSaved(0), options(options), boardTrees(new SearchTree<Board>[n]), boardSymmetries(new int[n]()) {
     // Enable nested parallelism
     omp_set_nested(1);
 }
@@ -22,266 +22,82 @@ struct MoveResult {
     bool validMove = false;
 };
 
-pUCTNode::pUCTNode(unsigned long state, bool chance, int a)
-    : value(0), visits(0), chance(chance), state(state)  {
-        if(chance)  {
-            action = a;
-        } else  {
-            action = -1;
-        }
-    }
-
-void pUCTNode::incrementVisits()  { visits++; }
-void pUCTNode::increaseValue(double v) { value += v; }
-
-// Merge policy
-int MCTSpUCT::moveToEnd(Game2048* currGame) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(*currGame);
-    
-    int score = 0;
-    Game2048::MoveResult result;
-    result.gameOver = false;
-
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-    
-    // Then do moves that maximize the merges until game over
-    while (!result.gameOver) {
-        // Test each possible move
-        std::vector<double> merges(4);
-        double sum = 0;
-        for (int move = 0; move < 4; move++) {
-            // Test if move is valid using a temporary copy
-            Game2048 testGame(gameCopy);
-            auto moveResult = testGame.moveWithoutSpawn(move);
-            
-            if (!moveResult.changed) {
-                continue;
-            }
-            
-            merges[move] = exp(moveResult.merges);
-            sum += merges[move];
-        }
-
-        for (int move = 0; move < 4; move++)  {
-            merges[move] /= sum;
-        }
-
-        double val = dis(gen);
-        int nextMove = 0;
-        double cp = 0.0;
-        for (int move = 0; move < 4; move++)  {
-            cp += merges[move];
-            if(val < cp)  {
-                nextMove = move;
-                break;
-            }
-        }
-
-        result = gameCopy.move(nextMove);
-        score += result.reward;
-    }
-    
-    return score;
-}
-
-// Random policy
-/*int MCTSpUCT::moveToEnd(Game2048* currGame) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(*currGame);
-    
-    // Then do random moves until game over
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<> dis(0, 3);
-
-    // First apply the move we're testing
-    auto result = gameCopy.move(dis(gen));
-    int score = result.reward;
-
-    int moves = 0;
-    
-    while (!result.gameOver) {
-        result = gameCopy.move(dis(gen));
-        score += result.reward;
-        ++moves;
-
-        if(moves > 10000)  {
-            std::cout << score << "\n";
-        }
-    }
-
-    //for(auto board : gameCopy.getBoards())  {
-    //    for(int i = 0; i < 16; i++)  {
-    //        score += board[i];
-    //    }
-    //}
-    
-    return score;
-}*/
-
-unsigned long MCTSpUCT::getBoardNum(Game2048* currGame, int gameIndex)  {
-    unsigned long val = 0;
-    auto board = currGame->getBoards()[gameIndex];
-
-    for(int i = 0; i < 16; i++)  {
-        val <<= 4;
-
-        unsigned long log = 0;
-        unsigned long tile = board[i];
-
-        while(tile > 0)  {
-            ++log;
-            tile /= 2;
-        }
-        val += log;
-    }
-
-    return val;
-}
-
-int MCTSpUCT::selectAction(pUCTNode* node)  {
-    if(node->children.size() != 4)  {
-        std::mt19937 gen(std::random_device{}());
-        std::uniform_int_distribution<> dis(0, 3 - node->children.size());
-        int take = dis(gen);
-
-        std::vector<bool> exist(4);
-        for(auto child : node->children)  {
-            exist[child->action] = true;
-        }
-
-        int index = 0;
-        for(int i = 0; i < 4; i++)  {
-            if(exist[i]) continue;
-
-            if(take == index)  {
-                return i;
-            }
-            ++index;
-        }
-
-        return -1;
-    } else  {
-        double bestUCB = -1;
-        int a = -1;
-
-        for(auto child : node->children)  {
-            double ucb = child->value / child->visits + C * sqrt(log(node->visits) / child->visits);
-            if(ucb > bestUCB)  {
-                bestUCB = ucb;
-                a = child->action;
-            }
-        }
-
-        return a;
-    }
-}
-
-double MCTSpUCT::sample(pUCTNode* node, Game2048* currGame, int gameIndex, int acquired)  {
-    // Create a fresh copy for this simulation
-    double before = node->value;
-
-    if(node->chance)  {
-        int acq = acquired;
-        auto children = node->children;
-        unsigned long state = getBoardNum(currGame, gameIndex);
-        pUCTNode* curr = nullptr;
-
-        for(auto child : children)  {
-            if(child->state == state)  {
-                curr = child;
-                break;
-            }
-        }
-
-        if(!curr)  {
-            curr = new pUCTNode(state, false, -1);
-            node->children.push_back(curr);
-        }
-
-        node->value += sample(curr, currGame, gameIndex, 0) + acq;
-    } else if(node->visits == 0.0)  {
-        node->value = moveToEnd(currGame);
-    } else  {
-        int a = selectAction(node);
-        
-        pUCTNode* curr = nullptr;
-        auto children = node->children;
-
-        for(auto child : children)  {
-            if(child->action == a)  {
-                curr = child;
-                break;
-            }
-        }
-        if(!curr)  {
-            curr = new pUCTNode(0, true, a);
-            node->children.push_back(curr);
-        }
-        auto result = currGame->move(a);
-
-        if(result.gameOver)  {
-            curr->visits++;
-        } else  {
-            node->value += sample(curr, currGame, gameIndex, result.reward);
-        }
-    }
-
-    node->visits += 1;
-
-    return node->value - before;
-}
-
-// Clear the Tree
-void MCTSpUCT::clearTree(pUCTNode* node, bool skipDelete)  {
-    if(!node->children.empty())  {
-        for(auto child : node->children)  {
-            clearTree(child, false);
-        }
-    }
-
-    if(!skipDelete)  {
-        delete node;
-    }
-}
-
 bool MCTSpUCT::makeMove() {
     std::vector<float> rewards(4);
-    std::vector<float> visits(4);
-    
-    // Test each possible move
-    for(int i = 0; i < game.numBoards; i++)  {
-
-        pUCTNode node(getBoardNum(&game, i), false, -1);
 
+    // Test each possible move. With early stopping, a forced move is played
+    // without searching, and each board stops once its own best move is secure.
+    Deadline deadline(options.moveTimeMs);
+    int legal = legalMoves(game.getBoardSet());
+    bool stopEarly = options.earlyStop > 0;
+    bool forced = stopEarly && __builtin_popcount(legal) == 1;
+
+    // The trees of the boards are independent, so they are searched in
+    // parallel, board i on thread i % threads. A thread with several boards
+    // gives each an equal share of the time against a deadline.
+    int threads = std::min(game.numBoards, omp_get_max_threads());
+    int rounds = (game.numBoards + threads - 1) / threads;
+    std::vector<float> boardRewards(4 * game.numBoards);
+    long long run = 0;
+    long long saved = 0;
+    #pragma omp parallel for schedule(static, 1) num_threads(threads) reduction(+:run, saved)
+    for(int i = 0; i < game.numBoards; i++)  {
+        // With symmetry, the tree of board i holds every position in the
+        // orientation that makes board i canonical. All boards turn with it,
+        // since they take the same moves.
+        BoardSet statei = game.getBoardSet();
+        int symmetry = options.symmetry ? canonicalSymmetry(statei[i]) : 0;
+        applySymmetry(statei, symmetry);
+        boardTrees[i].advanceOrClear(options.reuseTree && lastMove >= 0, applySymmetry(lastMove, boardSymmetries[i]), positionKey(statei, i));
+        boardSymmetries[i] = symmetry;
+
+        // Continue from the subtree kept from the last move, if any
+        PuctTree<Board>& tree = boardTrees[i].tree();
+        NodeIndex root = boardTrees[i].getRoot();
         // Evenly split the simulations to the games
-        for(int sim = 0; sim < simulations / game.numBoards; sim++)  {
-            Game2048 copyGame(game);
-
-            sample(&node, &copyGame, i, 0);
-        }
+        int budget = simulations / game.numBoards;
+        int first = tree.decision(root).visits;
+        int count = 0;
+
+        if(!forced)  {
+            count = runSimulations(first, budget, deadline.part(i / threads, rounds), stopEarly, options.threads, [&](int sim)  {
+                BoardSet copyState = statei;
+                Rng rng(streamSeed(STREAM_SEARCH, moveNumber, i, sim));
+
+                // Oblivious: the tree of board i only tells outcomes apart by board i
+                simulate<RolloutPolicy>(tree, root, copyState, C, options.leafRollouts, rng,
+                    [&](ChanceNode& chance, BoardSet& state)  {
+                        if(options.symmetry)  applySymmetry(state, canonicalSymmetry(state[i]));
+                        return tree.outcomeChild(chance, positionKey(state, i));
+                    });
+            }, [&]()  {
+                ActionStats stats[4];
+                addChildStats(tree, tree.decision(root), stats);
+                return leaderSecure(stats, legalMoves(statei), options.earlyStop);
+            });
+        }
+        run += count;
+        if(!deadline.active())  saved += std::max(0, budget - first - count);
 
         for(int move = 0; move < 4; move++)  {
-            Game2048 testGame(game);
-            auto moveResult = testGame.moveWithoutSpawn(move);
-            
-            if (!moveResult.changed) {
-                rewards[move] = -1;
-                continue;
+            NodeIndex child = tree.decision(root).children[applySymmetry(move, symmetry)];
+            if(child != NO_NODE)  {
+                ChanceNode& node = tree.chance(child);
+                boardRewards[4 * i + move] = (float) node.value / node.visits;
             }
+        }
+    }
+    simulationsRun += run;
+    simulationsSaved += saved;
 
-            for(auto child : node.children)  {
-                if(child->action == move)  {
-                    float val = (float) child->value / child->visits;
-                    rewards[move] += val;
-                    break;
-                }
-            }
+    // Sum the boards in order, so the move does not depend on the threads
+    for(int i = 0; i < game.numBoards; i++)  {
+        for(int move = 0; move < 4; move++)  {
+            rewards[move] += boardRewards[4 * i + move];
         }
-  
-        // Free the memory
-        clearTree(&node, true);
+    }
+    for(int move = 0; move < 4; move++)  {
+        if (!(legal & (1 << move))) rewards[move] = -1;
     }
     
     // Find best move
@@ -297,7 +113,9 @@ bool MCTSpUCT::makeMove() {
     // Make the actual move
     auto result = game.move(bestMove);
     points += result.reward;
-    
+    lastMove = bestMove;
+    moveNumber++;
+
     if (result.gameOver) {
         std::cout << "Game over! Total points: " << points << std::endl;
         std::cout << "Final board state:" << std::endl;
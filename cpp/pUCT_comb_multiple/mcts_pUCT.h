@@ -1,37 +1,39 @@
 // mcts_random.h
 #pragma once
+#include <memory>
 #include "env2048.h"
-
-class pUCTNode {
-public:
-    pUCTNode(unsigned long state, bool chance, int a);
-    std::vector<pUCTNode*> children;
-    double value;
-    double visits;
-    bool chance;
-    // action is for chance node only
-    int action;
-    unsigned long state;
-
-    void incrementVisits();
-    void increaseValue(double v);
-};
+#include "puct_tree.h"
+#include "position_key.h"
+#include "symmetry.h"
+#include "search_options.h"
+#include "puct_search.h"
 
 class MCTSpUCT {
 public:
-    MCTSpUCT(int n, int simulations, double C);
-    unsigned long getBoardNum(Game2048* currGame, int gameIndex);
-    int selectAction(pUCTNode* node);
-    double sample(pUCTNode* node, Game2048* currGame, int gameIndex, int acquired);
-    void clearTree(pUCTNode* node, bool skipDelete);
+    // Policy of the rollouts that evaluate new leaves, see rollout_policy.h
+    typedef MergePolicy RolloutPolicy;
+    MCTSpUCT(int n, int simulations, double C, const SearchOptions& options = SearchOptions());
     bool makeMove();  // Returns true if game is over
     int getPoints() const { return points; }
+    int getLastMove() const { return lastMove; }
+    long long getSimulations() const { return simulationsRun; }
+    long long getSimulationsSaved() const { return simulationsSaved; }
     const Game2048& getGame() const { return game; }
 
 private:
-    int moveToEnd(Game2048* currGame);
     Game2048 game;
     int simulations;
     int points;
     double C;
+    int moveNumber;
+    int lastMove;
+    long long simulationsRun;
+    long long simulationsSaved;  // Budget left unspent by stopping early
+
+    SearchOptions options;
+    // One search tree per board kept across moves, keyed by that board after
+    // each spawn
+    std::unique_ptr<SearchTree<Board>[]> boardTrees;
+    // Maps each board at the root to the orientation of its tree
+    std::unique_ptr<int[]> boardSymmetries;
 };
\ No newline at end of file
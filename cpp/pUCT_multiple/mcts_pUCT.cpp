@@ -1,19 +1,20 @@
 // mcts_pUCT.cpp
 #include "mcts_pUCT.h"
-#include <random>
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <iomanip>
 #include <cassert>
+#include <cmath>
 
 // pUCT for multiple games. Not Oblivious pUCT. Oblivious pUCT is in pUCT_comb_multiple/mcts_pUCT.cpp.
 
-MCTSpUCT::MCTSpUCT(int n, int simulations, double c_param) 
-    : game(n), simulations(4*simulations), points(0), acquired(0), C(c_param) {
+MCTSpUCT::MCTSpUCT(int n, int simulations, double c_param, const SearchOptions& options) 
+    : game(n), simulations(4*simulations), points(0), C(c_param), moveNumber(0), lastMove(-1), rootSymmetry(0), simulationsRun(0), simulationsSaved(0), options(options) {
     // Enable nested parallelism
     omp_set_nested(1);
+    search.setTranspositions(options.transpositions);
 }
 
 struct MoveResult {
@@ -22,283 +23,68 @@ struct MoveResult {
     bool validMove = false;
 };
 
-pUCTNode::pUCTNode(std::vector<unsigned long> stateParam, bool chance, int a)
-    : value(0), visits(0), chance(chance), state(stateParam.size()) {
-        if(chance)  {
-            action = a;
-        } else  {
-            action = -1;
-            for(unsigned long s : stateParam)  {
-                state.push_back(s);
-            }
-        }
-    }
-
-void pUCTNode::incrementVisits()  { visits++; }
-void pUCTNode::increaseValue(double v) { value += v; }
-
-/*int MCTSpUCT::moveToEnd(Game2048* currGame) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(*currGame);
-    
-    int score = 0;
-    Game2048::MoveResult result;
-    result.gameOver = false;
-
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-    
-    // Then do moves that maximize the merges until game over
-    while (!result.gameOver) {
-        // Test each possible move
-        std::vector<double> merges(4);
-        double sum = 0;
-        for (int move = 0; move < 4; move++) {
-            // Test if move is valid using a temporary copy
-            Game2048 testGame(gameCopy);
-            auto moveResult = testGame.moveWithoutSpawn(move);
-            
-            if (!moveResult.changed) {
-                continue;
-            }
-            
-            merges[move] = exp(moveResult.merges);
-            sum += merges[move];
-        }
-
-        for (int move = 0; move < 4; move++)  {
-            merges[move] /= sum;
-        }
-
-        double val = dis(gen);
-        int nextMove = 0;
-        double cp = 0.0;
-        for (int move = 0; move < 4; move++)  {
-            cp += merges[move];
-            if(val < cp)  {
-                nextMove = move;
-                break;
-            }
-        }
-
-        result = gameCopy.move(nextMove);
-        score += result.reward;
-    }
-    
-    return score;
-}*/
-
-int MCTSpUCT::moveToEnd(Game2048* currGame) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(*currGame);
-    
-    // Then do random moves until game over
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<> dis(0, 3);
-
-    // First apply the move we're testing
-    auto result = gameCopy.move(dis(gen));
-    int score = result.reward;
-
-    int moves = 0;
-    
-    while (!result.gameOver) {
-        result = gameCopy.move(dis(gen));
-        score += result.reward;
-        ++moves;
-    }
-
-    return score;
-}
-
-// One board
-unsigned long MCTSpUCT::getBoardNum(Game2048* currGame, int gameNum)  {
-    unsigned long val = 0;
-    
-    auto board = currGame->getBoards()[gameNum];
-    for(int i = 0; i < 16; i++)  {
-        val <<= 4;
-
-        unsigned long log = 0;
-        unsigned long tile = board[i];
-
-        while(tile > 0)  {
-            ++log;
-            tile /= 2;
-        }
-        val += log;
-    }
-
-    return val;
-}
-
-int MCTSpUCT::selectAction(pUCTNode* node)  {
-    if(node->children.size() != 4)  {
-        std::mt19937 gen(std::random_device{}());
-        std::uniform_int_distribution<> dis(0, 3 - node->children.size());
-        int take = dis(gen);
-
-        std::vector<bool> exist(4);
-        for(auto child : node->children)  {
-            exist[child->action] = true;
-        }
-
-        int index = 0;
-        for(int i = 0; i < 4; i++)  {
-            if(exist[i]) continue;
-
-            if(take == index)  {
-                return i;
-            }
-            ++index;
-        }
-
-        return -1;
-    } else  {
-        double bestUCB = -1;
-        int a = -1;
-
-        for(auto child : node->children)  {
-            double ucb = child->value / child->visits + C * sqrt(log(node->visits) / child->visits);
-            if(ucb > bestUCB)  {
-                bestUCB = ucb;
-                a = child->action;
-            }
-        }
-
-        return a;
-    }
-}
-
-bool pUCTNode::matches(std::vector<unsigned long> state2)  {
-    for(size_t i = 0; i < state.size(); i++)  {
-        if(state[i] != state2[i])  {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-double MCTSpUCT::sample(pUCTNode* node, Game2048* currGame)  {
-    double before = node->value;
-
-    if(node->chance)  {
-        int acq = acquired;
-        auto children = node->children;
-        std::vector<unsigned long> state(game.numBoards);
-        for(int i = 0; i < game.numBoards; i++)  {
-            state[i] = getBoardNum(currGame, i);
-        }
-        pUCTNode* curr = nullptr;
-
-        for(auto child : children)  {
-            if(child->matches(state))  {
-                curr = child;
-                break;
-            }
-        }
-
-        if(!curr)  {
-            curr = new pUCTNode(state, false, -1);
-            node->children.push_back(curr);
-        }
-
-        node->value += sample(curr, currGame) + acq;
-    } else if(node->visits == 0.0)  {
-        node->value = moveToEnd(currGame);
-    } else  {
-        int a = selectAction(node);
-        
-        pUCTNode* curr = nullptr;
-        auto children = node->children;
-
-        for(auto child : children)  {
-            if(child->action == a)  {
-                curr = child;
-                break;
-            }
-        }
-        if(!curr)  {
-            // Create a placeholder to use the constructor
-            std::vector<unsigned long> placeholder(1);
-            curr = new pUCTNode(placeholder, true, a);
-            node->children.push_back(curr);
-        }
-        auto result = currGame->move(a);
-
-        acquired = result.reward;
-
-        if(result.gameOver)  {
-            curr->visits++;
-        } else  {
-            node->value += sample(curr, currGame);
-        }
-
-        // Make sure we never make that move again since it did nothing.
-        if(!result.changed)  {
-            curr->visits = 100000000;
-        }
-    }
-
-    node->visits += 1;
-
-    return node->value - before;
-}
-
-// Clear the Tree
-void MCTSpUCT::clearTree(pUCTNode* node, bool skipDelete)  {
-    if(!node->children.empty())  {
-        for(auto child : node->children)  {
-            clearTree(child, false);
-        }
-    }
-
-    if(!skipDelete)  {
-        delete node;
-    }
-}
-
 bool MCTSpUCT::makeMove() {
     std::vector<float> rewards(4);
 
-    std::vector<unsigned long> board(game.numBoards);
-    for(int i = 0; i < game.numBoards; i++)  {
-        board[i] = getBoardNum(&game, i);
-    }
-    
-    pUCTNode node(board, false, -1);
-
-    // pUCT loop
-    for(int sim = 0; sim < simulations; sim++)  {
-        Game2048 copyGame(game);
-
-        sample(&node, &copyGame);
+    // With symmetry, the tree holds every position in its canonical
+    // orientation, and moves at the root are mapped to and from it.
+    Deadline deadline(options.moveTimeMs);
+    BoardSet rootState = game.getBoardSet();
+    int symmetry = options.symmetry ? canonicalSymmetry(rootState) : 0;
+    applySymmetry(rootState, symmetry);
+    search.advanceOrClear(options.reuseTree && lastMove >= 0, applySymmetry(lastMove, rootSymmetry), positionKey(rootState));
+    rootSymmetry = symmetry;
+
+    // Continue from the subtree kept from the last move, if any
+    NodeIndex root = search.getRoot();
+
+    // pUCT loop. With early stopping, a forced move is played without searching.
+    int legal = legalMoves(game.getBoardSet());
+    bool stopEarly = options.earlyStop > 0;
+    int first = tree().decision(root).visits;
+    int count = 0;
+    if(!stopEarly || __builtin_popcount(legal) > 1)  {
+        count = runSimulations(first, simulations, deadline, stopEarly, options.threads, [&](int sim)  {
+            BoardSet copyState = rootState;
+            Rng rng(streamSeed(STREAM_SEARCH, moveNumber, 0, sim));
+
+            simulate<RolloutPolicy>(tree(), root, copyState, C, options.leafRollouts, rng,
+                [&](ChanceNode& chance, BoardSet& state)  {
+                    if(options.symmetry)  applySymmetry(state, canonicalSymmetry(state));
+
+                    // The joint spawns multiply with the boards. Past the cap,
+                    // a new one is played out without a node of its own.
+                    JointKey key = positionKey(state);
+                    if(options.maxOutcomes > 0 && chance.count >= options.maxOutcomes)  {
+                        return tree().findOutcome(chance, keyHash(key), [&](const JointKey& k)  { return k == key; });
+                    }
+                    return tree().outcomeChild(chance, key);
+                });
+        }, [&]()  {
+            ActionStats stats[4];
+            addChildStats(tree(), tree().decision(root), stats);
+            return leaderSecure(stats, legalMoves(rootState), options.earlyStop);
+        });
     }
+    simulationsRun += count;
+    if(!deadline.active())  simulationsSaved += std::max(0, simulations - first - count);
 
     std::vector<double> valuevalue(4);
     std::vector<double> visitsvisits(4);
     for(int move = 0; move < 4; move++)  {
-        Game2048 testGame(game);
-        auto moveResult = testGame.moveWithoutSpawn(move);
-        
-        if (!moveResult.changed) {
+        if (!(legal & (1 << move))) {
             rewards[move] = -1;
             continue;
         }
 
-        for(auto child : node.children)  {
-            if(child->action == move)  {
-                rewards[move] = (float) child->value / child->visits;
-                valuevalue[move] = child->value;
-                visitsvisits[move] = child->visits;
-                break;
-            }
+        NodeIndex child = tree().decision(root).children[applySymmetry(move, rootSymmetry)];
+        if(child != NO_NODE)  {
+            ChanceNode& node = tree().chance(child);
+            rewards[move] = (float) node.value / node.visits;
+            valuevalue[move] = node.value;
+            visitsvisits[move] = node.visits;
         }
     }
-
-    // Free the memory
-    clearTree(&node, true);
     
     // Find best move
     int bestMove = 0;
@@ -323,7 +109,9 @@ bool MCTSpUCT::makeMove() {
     // Make the actual move
     auto result = game.move(bestMove);
     points += result.reward;
-    
+    lastMove = bestMove;
+    moveNumber++;
+
     if (result.gameOver) {
         std::cout << "Game over! Total points: " << points << std::endl;
         std::cout << "Final board state:" << std::endl;
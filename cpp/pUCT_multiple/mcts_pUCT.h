@@ -1,40 +1,39 @@
 // mcts_random.h
 #pragma once
 #include "env2048.h"
-
-class pUCTNode {
-public:
-    pUCTNode(std::vector<unsigned long> state, bool chance, int a);
-    std::vector<pUCTNode*> children;
-    double value;
-    double visits;
-    bool chance;
-    // action is for chance node only
-    int action;
-    std::vector<unsigned long> state;
-
-    void incrementVisits();
-    void increaseValue(double v);
-    bool matches(std::vector<unsigned long> state2);
-};
+#include "puct_tree.h"
+#include "position_key.h"
+#include "symmetry.h"
+#include "search_options.h"
+#include "puct_search.h"
 
 class MCTSpUCT {
 public:
+    // Policy of the rollouts that evaluate new leaves, see rollout_policy.h
+    typedef RandomPolicy RolloutPolicy;
 
-    MCTSpUCT(int n, int simulations, double c_param = 800.0);  // Added C parameter with default
-    unsigned long getBoardNum(Game2048* currGame, int gameNum);
-    int selectAction(pUCTNode* node);
-    double sample(pUCTNode* node, Game2048* currGame);
-    void clearTree(pUCTNode* node, bool skipDelete);
+    MCTSpUCT(int n, int simulations, double c_param = 800.0, const SearchOptions& options = SearchOptions());  // Added C parameter with default
     bool makeMove();  // Returns true if game is over
     int getPoints() const { return points; }
+    int getLastMove() const { return lastMove; }
+    long long getSimulations() const { return simulationsRun; }
+    long long getSimulationsSaved() const { return simulationsSaved; }
     const Game2048& getGame() const { return game; }
 
 private:
-    int moveToEnd(Game2048* currGame);
     Game2048 game;
     int simulations;
     int points;
-    int acquired;
     double C;
+    int moveNumber;
+    int lastMove;
+    int rootSymmetry;  // Maps the boards at the root to the tree's orientation
+    long long simulationsRun;
+    long long simulationsSaved;  // Budget left unspent by stopping early
+    PuctTree<JointKey>& tree() { return search.tree(); }
+
+    SearchOptions options;
+    // Search tree kept across moves, keyed by a fixed-width hash of all boards
+    // after each spawn
+    SearchTree<JointKey> search;
 };
\ No newline at end of file
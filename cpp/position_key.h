@@ -0,0 +1,51 @@
+// position_key.h
+#pragma once
+#include <cstdint>
+#include "board_state.h"
+#include "rng.h"
+
+// Keys of search positions, for the outcome tables and transposition tables
+// of every pUCT variant. All of them are fixed-width whatever the number of
+// boards.
+
+// One board: the packed board is already an exact 64-bit key
+inline Board positionKey(const BoardState& state) { return state.board; }
+inline Board positionKey(const BoardSet& set, int b) { return set[b]; }
+
+// Hash of a board key for the tree's tables
+inline uint64_t keyHash(Board key) { return mix64(key); }
+
+// All boards of a position: 128 bits, compared as one value. Different
+// positions collide with probability about 2^-128 per compare, which a search
+// never reaches.
+struct JointKey {
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const JointKey& other) const { return lo == other.lo && hi == other.hi; }
+};
+
+// Zobrist-style: the key is the xor of an independent random code for each
+// board and its slot. Unlike a hash chained board after board, the codes do
+// not wait on each other, so the loop over boards pipelines and vectorizes.
+// Every board changes on every move (at least by its spawn), so the search
+// computes the key afresh after each step rather than updating it.
+inline JointKey boardCode(int b, Board board) {
+    uint64_t slot = (uint64_t) (b + 1) * 0x9E3779B97F4A7C15ULL;
+    return {mix64(board + slot), mix64((board ^ slot) * 0xD6E8FEB86659FD93ULL)};
+}
+
+inline JointKey positionKey(const BoardSet& set) {
+    JointKey key = {0, 0};
+    for (int b = 0; b < set.numBoards; b++) {
+        JointKey code = boardCode(b, set[b]);
+        key.lo ^= code.lo;
+        key.hi ^= code.hi;
+    }
+    return key;
+}
+
+// Hash of a joint key for the tree's tables: one half is already well mixed
+inline uint64_t keyHash(const JointKey& key) {
+    return key.lo;
+}
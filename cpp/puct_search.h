@@ -0,0 +1,148 @@
+// puct_search.h
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "puct_tree.h"
+#include "batch_rollout.h"
+#include "search_budget.h"
+
+// The pUCT simulation shared by the pUCT variants: one loop down the tree that
+// records the path, then one pass back up it, instead of a recursive call per
+// level. Safe to run on several threads over one tree, see puct_tree.h.
+
+// Simulations per thread between two looks at the clock or at the root
+// statistics for stopping early
+const int CHECK_INTERVAL = 4;
+
+// Decision nodes on the path of one simulation. A node this deep is evaluated
+// by a playout like a new leaf, without growing the tree below it.
+const int MAX_PATH = 512;
+
+// Action to take at a decision node that had been visited visits times: a
+// random untried legal move, else the child with the highest UCB, the lowest
+// action on ties. A child that another thread has just linked in but not yet
+// visited counts as untried.
+template <class Key>
+int selectAction(PuctTree<Key>& tree, DecisionNode& node, uint32_t visits, int legal, double C, Rng& rng) {
+    NodeIndex children[4];
+    uint32_t childVisits[4];
+    int untried = legal;
+    for (int a = 0; a < 4; a++) {
+        children[a] = __atomic_load_n(&node.children[a], __ATOMIC_ACQUIRE);
+        if (children[a] == NO_NODE) continue;
+        childVisits[a] = __atomic_load_n(&tree.chance(children[a]).visits, __ATOMIC_RELAXED);
+        if (childVisits[a] > 0) untried &= ~(1 << a);
+    }
+    if (untried) return randomMove(untried, rng);
+
+    double bestUCB = -1;
+    int best = -1;
+    for (int a = 0; a < 4; a++) {
+        if (children[a] == NO_NODE) continue;
+        double value;
+        __atomic_load(&tree.chance(children[a]).value, &value, __ATOMIC_RELAXED);
+        double ucb = value / childVisits[a] + C * sqrt(log(visits) / childVisits[a]);
+        if (ucb > bestUCB) {
+            bestUCB = ucb;
+            best = a;
+        }
+    }
+    return best;
+}
+
+// Run one simulation from root, whose position is state, and return the reward
+// collected. New leaves are evaluated by the mean of leafRollouts playouts
+// of Policy. outcome(chanceNode, state) returns the decision node reached
+// from a chance node by the spawn that just happened in state, or NO_NODE to
+// evaluate that position like a new leaf without adding it to the tree. It may
+// also turn state into a mirror image, whose moves the node's children are.
+template <class Policy, class Key, class State, class Outcome>
+double simulate(PuctTree<Key>& tree, NodeIndex root, State& state, double C, int leafRollouts,
+                Rng& rng, Outcome outcome) {
+    // A decision node, and the chance node below it with the reward of the
+    // move that led there, or nullptr if the simulation stopped at the node
+    struct Step {
+        DecisionNode* node;
+        ChanceNode* chance;
+        int acquired;
+    };
+    Step path[MAX_PATH];
+    int depth = 0;
+    double reward = 0;
+
+    // Selection and expansion. Visits are counted on the way down.
+    DecisionNode* node = &tree.decision(root);
+    while (true) {
+        Step& current = path[depth++];
+        current.node = node;
+        current.chance = nullptr;
+
+        uint32_t visits = addVisit(node->visits);
+        if (visits == 0 || depth == MAX_PATH) {
+            reward = meanPlayout<Policy>(state, leafRollouts, rng);
+            break;
+        }
+
+        int a = selectAction(tree, *node, visits, legalMoves(state), C, rng);
+        ChanceNode& chance = tree.chance(tree.chanceChild(*node, a));
+        addVisit(chance.visits);
+        auto result = step(state, a, rng);
+        if (result.gameOver) break;
+
+        current.chance = &chance;
+        current.acquired = result.reward;
+        NodeIndex next = outcome(chance, state);
+        if (next == NO_NODE) {
+            reward = meanPlayout<Policy>(state, leafRollouts, rng);
+            break;
+        }
+        node = &tree.decision(next);
+    }
+
+    // Backup
+    for (int i = depth - 1; i >= 0; i--) {
+        if (path[i].chance) {
+            reward += path[i].acquired;
+            addValue(path[i].chance->value, reward);
+            addValue(path[i].chance->squares, reward * reward);
+        }
+        addValue(path[i].node->value, reward);
+    }
+    return reward;
+}
+
+// Add the returns seen below each child of node to stats
+template <class Key>
+void addChildStats(PuctTree<Key>& tree, const DecisionNode& node, ActionStats stats[4]) {
+    for (int a = 0; a < 4; a++) {
+        if (node.children[a] == NO_NODE) continue;
+        const ChanceNode& child = tree.chance(node.children[a]);
+        stats[a].sum += child.value;
+        stats[a].squares += child.squares;
+        stats[a].count += child.visits;
+    }
+}
+
+// Call simulation(sim) for sim = first up to budget on threads threads, or
+// until the deadline instead if it is active. With stopEarly, also stop as
+// soon as settled() holds between two rounds. Returns the number run.
+template <class Simulation, class Settled>
+int runSimulations(int first, int budget, const Deadline& deadline, bool stopEarly, int threads,
+                   Simulation simulation, Settled settled) {
+    if (deadline.active()) budget = INT_MAX;
+    bool rounds = deadline.active() || stopEarly;
+
+    int sim = first;
+    while (sim < budget) {
+        if (stopEarly && settled()) break;
+        int end = rounds ? std::min(budget, sim + CHECK_INTERVAL * threads) : budget;
+        #pragma omp parallel for schedule(dynamic) num_threads(threads)
+        for (int s = sim; s < end; s++) {
+            simulation(s);
+        }
+        sim = end;
+        if (deadline.passed()) break;
+    }
+    return std::max(0, sim - first);
+}
@@ -0,0 +1,387 @@
+// puct_tree.h
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "arena.h"
+#include "position_key.h"
+#include "rng.h"
+
+// Compact pUCT search tree shared by the pUCT variants. Nodes refer to each
+// other by 32-bit indices into pools, and the whole tree is freed in O(1).
+//
+// Several threads may search one tree at once. Statistics are updated with
+// the atomic helpers below, children are linked in with compare-and-swap, and
+// only allocation and new spawn outcomes take the tree's lock.
+
+typedef uint32_t NodeIndex;
+const NodeIndex NO_NODE = UINT32_MAX;
+
+// A position where the player picks one of the four moves. 32 bytes, so two
+// share a cache line.
+struct DecisionNode {
+    double value;           // Sum of the returns backed up through this node
+    uint32_t visits;
+    NodeIndex children[4];  // Chance node reached by each action, or NO_NODE
+
+    DecisionNode() : value(0), visits(0), children{NO_NODE, NO_NODE, NO_NODE, NO_NODE} {}
+};
+
+// The position after a move, before the spawn. Its children are the spawn
+// outcomes seen so far, in a small open-addressing table of its own. 32 bytes.
+struct ChanceNode {
+    double value;
+    double squares;     // Sum of the squared returns, for the spread of value
+    uint32_t visits;
+    uint32_t slots;     // First slot of the outcome table in the slot pool
+    uint32_t capacity;  // Table size, a power of two, 0 until the first outcome
+    uint32_t count;     // Outcomes in the table
+
+    ChanceNode() : value(0), squares(0), visits(0), slots(0), capacity(0), count(0) {}
+};
+
+// Count a visit and return the number before it. Visits are counted on the way
+// down and values added on the way back, so a simulation still in progress
+// counts as a visit that returned nothing: a virtual loss that steers other
+// threads elsewhere.
+inline uint32_t addVisit(uint32_t& visits) {
+    uint32_t before;
+    #pragma omp atomic capture
+    before = visits++;
+    return before;
+}
+
+inline void addValue(double& value, double amount) {
+    #pragma omp atomic
+    value += amount;
+}
+
+// One slot of an outcome table
+template <class Key>
+struct OutcomeSlot {
+    Key key;
+    uint32_t hash;    // Low bits of the key's hash, to regrow and to skip most compares
+    NodeIndex child;  // Decision node reached, or NO_NODE for an empty slot
+
+    OutcomeSlot() : key(), hash(0), child(NO_NODE) {}
+};
+
+// Key identifies a spawn outcome, typically the board after the spawn.
+//
+// With transpositions on, outcomes with equal keys share one decision node
+// wherever they are reached, so the tree is a DAG and every visit to a
+// position counts for all the move orders that lead to it. There are no
+// cycles: every spawn adds to the tile sum, and moves keep it.
+template <class Key>
+class PuctTree {
+public:
+    PuctTree() : transpositionLimit(0), transpositionCount(0) {}
+
+    // Index at most limit outcomes (rounded down to a power of two) in the
+    // transposition table, or none with 0. Set before searching.
+    void setTranspositions(uint32_t limit) {
+        transpositionLimit = limit;
+    }
+
+    DecisionNode& decision(NodeIndex i) { return decisions[i]; }
+    ChanceNode& chance(NodeIndex i) { return chances[i]; }
+
+    // Not thread-safe, for building the tree outside of a search
+    NodeIndex addDecision() { return decisions.add(); }
+    NodeIndex addChance() { return chances.add(); }
+
+    // Chance node below action a of a decision node, created on first use
+    NodeIndex chanceChild(DecisionNode& node, int a) {
+        NodeIndex child = __atomic_load_n(&node.children[a], __ATOMIC_ACQUIRE);
+        if (child != NO_NODE) return child;
+
+        NodeIndex fresh;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            fresh = addChance();
+        }
+        // If another thread expanded the action first, fresh is left unused
+        if (__atomic_compare_exchange_n(&node.children[a], &child, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return fresh;
+        }
+        return child;
+    }
+
+    // Decision node reached from a chance node by the outcome whose key
+    // satisfies matches(key), or NO_NODE. hash must be the same for equal keys.
+    //
+    // Safe while other threads add outcomes: a slot is filled before its
+    // child is set, and a grown table is filled before it replaces the old
+    // one. A lookup that races with an insert may miss it, see outcomeChild.
+    template <class Matches>
+    NodeIndex findOutcome(ChanceNode& node, uint64_t hash, Matches matches) {
+        uint32_t capacity = __atomic_load_n(&node.capacity, __ATOMIC_ACQUIRE);
+        if (capacity == 0) return NO_NODE;
+        // Read after capacity, so the table has at least capacity slots
+        uint32_t first = __atomic_load_n(&node.slots, __ATOMIC_ACQUIRE);
+
+        uint32_t mask = capacity - 1;
+        uint32_t i = hash & mask;
+        for (uint32_t probes = 0; probes < capacity; probes++, i = (i + 1) & mask) {
+            OutcomeSlot<Key>& slot = slots[first + i];
+            NodeIndex child = __atomic_load_n(&slot.child, __ATOMIC_ACQUIRE);
+            if (child == NO_NODE) break;
+            if (slot.hash == (uint32_t) hash && matches(slot.key)) return child;
+        }
+        return NO_NODE;
+    }
+
+    // Same, but the outcome is added with key newKey() if it is new. A table
+    // is one range of the slot pool, so it stops growing at the largest range
+    // and further new outcomes return NO_NODE: the search evaluates them by a
+    // playout without adding a node, as past a cap on the outcomes.
+    template <class Matches, class NewKey>
+    NodeIndex outcomeChild(ChanceNode& node, uint64_t hash, Matches matches, NewKey newKey) {
+        NodeIndex found = findOutcome(node, hash, matches);
+        if (found != NO_NODE) return found;
+
+        // Look again under the lock, another thread may have just added it
+        std::lock_guard<std::mutex> guard(mutex);
+        found = findOutcome(node, hash, matches);
+        if (found != NO_NODE) return found;
+
+        // Keep the table at most half full
+        if (node.capacity == 0 || 2 * (node.count + 1) > node.capacity) {
+            if (2 * node.capacity > slots.maxRange()) return NO_NODE;
+            grow(node);
+        }
+
+        uint32_t mask = node.capacity - 1;
+        uint32_t i = hash & mask;
+        while (slots[node.slots + i].child != NO_NODE) i = (i + 1) & mask;
+        OutcomeSlot<Key>& slot = slots[node.slots + i];
+        slot.key = newKey();
+        slot.hash = (uint32_t) hash;
+        NodeIndex child = transposition(slot.key, (uint32_t) hash, matches);
+        __atomic_store_n(&slot.child, child, __ATOMIC_RELEASE);
+        node.count++;
+        return child;
+    }
+
+    // Same, for keys with a keyHash, see position_key.h
+    NodeIndex outcomeChild(ChanceNode& node, Key key) {
+        return outcomeChild(node, keyHash(key), [&](Key k) { return k == key; }, [&]() { return key; });
+    }
+
+    // Copy the subtree below root of other into this tree and return its new
+    // root. copyKey(key, *this) returns the key to store here. Shared nodes
+    // stay shared, and are indexed here if transpositions are on.
+    template <class CopyKey>
+    NodeIndex copySubtree(PuctTree& other, NodeIndex root, CopyKey copyKey) {
+        std::vector<NodeIndex> copied(other.decisions.size(), NO_NODE);
+        return copySubtree(other, root, copyKey, copied);
+    }
+
+    // Storage for keys that do not fit in Key itself, freed with the tree
+    Arena& keyStorage() { return keys; }
+
+    // Drop the whole tree
+    void reset() {
+        decisions.reset();
+        chances.reset();
+        slots.reset();
+        keys.reset();
+        transpositions.clear();
+        transpositionCount = 0;
+    }
+
+private:
+    // Entries probed for a key before the table gives up on it
+    static const uint32_t PROBES = 8;
+
+    // copied maps nodes of other to their copy here, or NO_NODE
+    template <class CopyKey>
+    NodeIndex copySubtree(PuctTree& other, NodeIndex root, CopyKey copyKey, std::vector<NodeIndex>& copied) {
+        NodeIndex index = addDecision();
+        copied[root] = index;
+        decision(index) = other.decision(root);
+        for (int a = 0; a < 4; a++) {
+            NodeIndex from = other.decision(root).children[a];
+            if (from == NO_NODE) continue;
+
+            NodeIndex to = addChance();
+            ChanceNode& source = other.chance(from);
+            chance(to) = source;
+            if (source.capacity > 0) chance(to).slots = slots.addRange(source.capacity);
+            for (uint32_t i = 0; i < source.capacity; i++) {
+                OutcomeSlot<Key>& slot = other.slots[source.slots + i];
+                if (slot.child == NO_NODE) continue;
+                OutcomeSlot<Key> copy;
+                copy.key = copyKey(slot.key, *this);
+                copy.hash = slot.hash;
+                copy.child = copied[slot.child];
+                if (copy.child == NO_NODE) {
+                    copy.child = copySubtree(other, slot.child, copyKey, copied);
+                    if (transpositionLimit > 0) addTransposition(copy);
+                }
+                slots[chance(to).slots + i] = copy;
+            }
+            decision(index).children[a] = to;
+        }
+        return index;
+    }
+
+    // Decision node for a new outcome with this key: the one indexed under an
+    // equal key, or a new node that is indexed in turn
+    template <class Matches>
+    NodeIndex transposition(Key key, uint32_t hash, Matches matches) {
+        if (transpositionLimit == 0) return addDecision();
+
+        uint32_t mask = (uint32_t) transpositions.size() - 1;
+        for (uint32_t p = 0; p < PROBES && !transpositions.empty(); p++) {
+            OutcomeSlot<Key>& entry = transpositions[(hash + p) & mask];
+            if (entry.child == NO_NODE) break;
+            if (entry.hash == hash && matches(entry.key)) return entry.child;
+        }
+
+        OutcomeSlot<Key> entry;
+        entry.key = key;
+        entry.hash = hash;
+        entry.child = addDecision();
+        addTransposition(entry);
+        return entry.child;
+    }
+
+    // Add entry to the transposition table. The table doubles while it is
+    // over half full and under the limit. Past that, an entry whose probe
+    // window is full replaces the least visited node in it: that node stays
+    // in the tree, but is no longer shared with new parents.
+    void addTransposition(const OutcomeSlot<Key>& entry) {
+        uint32_t capacity = (uint32_t) transpositions.size();
+        if (capacity == 0 || (2 * (transpositionCount + 1) > capacity && 2 * capacity <= transpositionLimit)) {
+            growTranspositions();
+        }
+
+        uint32_t mask = (uint32_t) transpositions.size() - 1;
+        OutcomeSlot<Key>* victim = nullptr;
+        for (uint32_t p = 0; p < PROBES; p++) {
+            OutcomeSlot<Key>& slot = transpositions[(entry.hash + p) & mask];
+            if (slot.child == NO_NODE) {
+                slot = entry;
+                transpositionCount++;
+                return;
+            }
+            if (!victim || decision(slot.child).visits < decision(victim->child).visits) victim = &slot;
+        }
+        *victim = entry;
+    }
+
+    void growTranspositions() {
+        std::vector<OutcomeSlot<Key>> old;
+        old.swap(transpositions);
+        uint32_t capacity = old.empty() ? 1024 : 2 * (uint32_t) old.size();
+        while (capacity > 1 && capacity > transpositionLimit) capacity /= 2;
+        transpositions.assign(capacity, OutcomeSlot<Key>());
+        transpositionCount = 0;
+        for (const OutcomeSlot<Key>& entry : old) {
+            if (entry.child != NO_NODE) addTransposition(entry);
+        }
+    }
+
+    // Move the outcomes of node into a table twice the size, or create its
+    // first table. The old slots are left unused until the next reset.
+    void grow(ChanceNode& node) {
+        uint32_t capacity = node.capacity == 0 ? 4 : 2 * node.capacity;
+        uint32_t first = slots.addRange(capacity);
+
+        uint32_t mask = capacity - 1;
+        for (uint32_t j = 0; j < node.capacity; j++) {
+            OutcomeSlot<Key>& old = slots[node.slots + j];
+            if (old.child == NO_NODE) continue;
+            uint32_t i = old.hash & mask;
+            while (slots[first + i].child != NO_NODE) i = (i + 1) & mask;
+            slots[first + i] = old;
+        }
+
+        // Publish the slots before the capacity, see findOutcome
+        __atomic_store_n(&node.slots, first, __ATOMIC_RELEASE);
+        __atomic_store_n(&node.capacity, capacity, __ATOMIC_RELEASE);
+    }
+
+    Pool<DecisionNode> decisions;
+    Pool<ChanceNode> chances;
+    Pool<OutcomeSlot<Key>> slots;
+    Arena keys;
+    // Held to allocate while other threads search
+    std::mutex mutex;
+
+    // Decision nodes by key, for sharing them between parents
+    uint32_t transpositionLimit;
+    uint32_t transpositionCount;
+    std::vector<OutcomeSlot<Key>> transpositions;
+};
+
+// A search tree that lives across moves. After a move, the subtree under the
+// played action and the observed spawn becomes the next root: it is copied
+// into a second tree and the rest is freed in O(1).
+template <class Key>
+class SearchTree {
+public:
+    SearchTree() : current(0), root(NO_NODE) {}
+
+    PuctTree<Key>& tree() { return trees[current]; }
+
+    // See PuctTree::setTranspositions
+    void setTranspositions(uint32_t limit) {
+        trees[0].setTranspositions(limit);
+        trees[1].setTranspositions(limit);
+    }
+
+    // Root of the next search, created empty if nothing was kept
+    NodeIndex getRoot() {
+        if (root == NO_NODE) root = tree().addDecision();
+        return root;
+    }
+
+    // Keep the subtree reached by action and the outcome matching hash and
+    // matches, or drop everything if it was never searched
+    template <class Matches, class CopyKey>
+    void advance(int action, uint64_t hash, Matches matches, CopyKey copyKey) {
+        PuctTree<Key>& from = tree();
+        PuctTree<Key>& to = trees[1 - current];
+        NodeIndex next = NO_NODE;
+        if (root != NO_NODE && from.decision(root).children[action] != NO_NODE) {
+            next = from.findOutcome(from.chance(from.decision(root).children[action]), hash, matches);
+        }
+
+        to.reset();
+        root = next == NO_NODE ? NO_NODE : to.copySubtree(from, next, copyKey);
+        from.reset();
+        current = 1 - current;
+    }
+
+    // Same, for keys with a keyHash, see position_key.h
+    void advance(int action, Key key) {
+        advance(action, keyHash(key), [&](Key k) { return k == key; }, [](Key k, PuctTree<Key>&) { return k; });
+    }
+
+    // Start the search of a new move. With reuse, keep the subtree reached by
+    // the last move, action, and the spawn after it, which led to the
+    // position with this key. Without, as before the first move, drop
+    // everything. Engines call this at the start of a move rather than at
+    // the end of the last, so that the copy counts toward the new move's
+    // deadline.
+    void advanceOrClear(bool reuse, int action, Key key) {
+        if (reuse) {
+            advance(action, key);
+        } else {
+            clear();
+        }
+    }
+
+    // Drop everything
+    void clear() {
+        tree().reset();
+        root = NO_NODE;
+    }
+
+private:
+    PuctTree<Key> trees[2];
+    int current;
+    NodeIndex root;
+};
@@ -1,13 +1,13 @@
 // mcts_random.cpp
 #include "mcts_random.h"
-#include <random>
+#include "flat_search.h"
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <iomanip>
-MCTSRandom::MCTSRandom(int n, int simulations, double c_param) 
-    : game(n), simulations(simulations), points(0) {
+MCTSRandom::MCTSRandom(int n, int simulations, double c_param, const SearchOptions& options) 
+    : game(n), simulations(simulations), points(0), moveNumber(0), lastMove(-1), simulationsRun(0), simulationsSaved(0), options(options) {
     // Enable nested parallelism
     omp_set_nested(1);
 }
@@ -18,48 +18,11 @@ struct MoveResult {
     bool validMove = false;
 };
 
-int MCTSRandom::randomToEnd(int move) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(game);
-    
-    // First apply the move we're testing
-    auto result = gameCopy.move(move);
-    int score = result.reward;
-    
-    // Then do random moves until game over
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<> dis(0, 3);
-    
-    while (!result.gameOver) {
-        result = gameCopy.move(dis(gen));
-        score += result.reward;
-    }
-    
-    return score;
-}
-
 bool MCTSRandom::makeMove() {
     std::vector<float> rewards(4);
     
     // Test each possible move
-    for (int move = 0; move < 4; move++) {
-        // Test if move is valid using a temporary copy
-        Game2048 testGame(game);
-        auto moveResult = testGame.moveWithoutSpawn(move);
-        
-        if (!moveResult.changed) {
-            rewards[move] = -1;
-            continue;
-        }
-        
-        // Run B simulations for this move
-        int score_sum = 0;
-        #pragma omp parallel for reduction(+:score_sum)
-        for (int sim = 0; sim < simulations; sim++) {
-            score_sum += randomToEnd(move);
-        }
-        rewards[move] = score_sum;
-    }
+    simulationsRun += flatSearch<RandomPolicy>(game.getBoardSet(), moveNumber, simulations, options, rewards, simulationsSaved);
     
     // Find best move
     int bestMove = 0;
@@ -81,6 +44,8 @@ bool MCTSRandom::makeMove() {
     // Make the actual move
     auto result = game.move(bestMove);
     points += result.reward;
+    lastMove = bestMove;
+    moveNumber++;
     
     if (result.gameOver) {
         std::cout << "Game over! Total points: " << points << std::endl;
@@ -0,0 +1,18 @@
+// rng.cpp
+#include "rng.h"
+#include <random>
+
+namespace {
+
+uint64_t randomSeed() {
+    std::random_device rd;
+    return ((uint64_t) rd() << 32) ^ rd();
+}
+
+uint64_t master = randomSeed();
+
+}
+
+void setMasterSeed(uint64_t seed) { master = seed; }
+uint64_t masterSeed() { return master; }
+
@@ -0,0 +1,87 @@
+// rng.h
+#pragma once
+#include <cstdint>
+
+// Final mixing step of splitmix64, a good 64-bit hash
+inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// splitmix64 step, used to expand seeds into generator state
+inline uint64_t splitmix64(uint64_t& state) {
+    return mix64(state += 0x9E3779B97F4A7C15ULL);
+}
+
+// Hash a seed together with up to four stream keys into an independent seed.
+// Keys name what a stream is for (game, move, simulation), never which thread
+// draws from it, so results do not depend on the number of threads.
+inline uint64_t deriveSeed(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0) {
+    const uint64_t gamma = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = mix64(seed + gamma);
+    h = mix64((h ^ a) + gamma);
+    h = mix64((h ^ b) + gamma);
+    h = mix64((h ^ c) + gamma);
+    return mix64((h ^ d) + gamma);
+}
+
+// xoshiro256** generator. 32 bytes of state, a few cycles per draw, and
+// trivially copyable so it can live inside every game copy.
+class Rng {
+public:
+    typedef uint64_t result_type;
+
+    explicit Rng(uint64_t seed = 0) { reseed(seed); }
+
+    void reseed(uint64_t seed) {
+        for (int i = 0; i < 4; i++) s[i] = splitmix64(seed);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, n), Lemire's multiply-shift without rejection.
+    // The bias is below n / 2^32, far under anything a rollout can notice.
+    uint32_t nextBelow(uint32_t n) {
+        return (uint32_t) (((next() >> 32) * n) >> 32);
+    }
+
+    // Uniform double in [0, 1)
+    double nextDouble() { return (next() >> 11) * 0x1.0p-53; }
+
+    // UniformRandomBitGenerator interface for use with <random> distributions
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+    result_type operator()() { return next(); }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s[4];
+};
+
+// Streams derived from the master seed
+enum SeedStream {
+    STREAM_ENV = 1,     // Spawns of the real game
+    STREAM_SEARCH = 2   // Rollouts and tree search, keyed by move and simulation
+};
+
+// Every random stream in a run is derived from the master seed, so a game is
+// reproduced exactly by running again with the same seed. Set it before any
+// game is constructed. Defaults to a random_device draw.
+void setMasterSeed(uint64_t seed);
+uint64_t masterSeed();
+
+inline uint64_t streamSeed(uint64_t stream, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0) {
+    return deriveSeed(masterSeed(), stream, a, b, c);
+}
@@ -0,0 +1,90 @@
+// rollout_policy.h
+#pragma once
+#include <cmath>
+#include "board_state.h"
+
+// Rollout policies and the playout loop shared by every search engine.
+//
+// A policy is any type with a const member
+//     template <class State> int choose(const State& state, int legal, Rng& rng);
+// that returns one of the set bits of the legal-move mask. Engines pick their
+// policy as a template argument, so choose() is inlined into the playout loop.
+
+// Pick a move with probability proportional to its weight. Illegal moves
+// must have weight 0 and at least one weight must be positive.
+inline int sampleMove(double weights[4], Rng& rng) {
+    double sum = weights[0] + weights[1] + weights[2] + weights[3];
+    for (int move = 0; move < 4; move++) {
+        weights[move] /= sum;
+    }
+
+    double val = rng.nextDouble();
+    double cp = 0.0;
+    for (int move = 0; move < 4; move++) {
+        cp += weights[move];
+        if (val < cp) return move;
+    }
+    return 0;
+}
+
+// Uniform over the legal moves
+struct RandomPolicy {
+    template <class State>
+    int choose(const State&, int legal, Rng& rng) const { return randomMove(legal, rng); }
+};
+
+// Base for policies that only look at the outcome of each legal move.
+// Derived defines static double weight(const StepResult&), and moves are
+// sampled proportionally to it. The batch kernel evaluates these in SIMD.
+template <class Derived>
+struct WeightedPolicy {
+    template <class State>
+    int choose(const State& state, int legal, Rng& rng) const {
+        double weights[4] = {0, 0, 0, 0};
+        for (int move = 0; move < 4; move++) {
+            if (legal & (1 << move)) weights[move] = Derived::weight(evaluateMove(state, move));
+        }
+        return sampleMove(weights, rng);
+    }
+};
+
+// exp(merges) for every merge count a move can produce (at most 8 per board)
+struct ExpTable {
+    double values[8 * MAX_BOARDS + 1];
+    ExpTable() {
+        for (int m = 0; m <= 8 * MAX_BOARDS; m++) values[m] = exp(m);
+    }
+};
+
+inline const ExpTable mergeExp;
+
+// Softmax over the number of merges a move makes
+struct MergePolicy : WeightedPolicy<MergePolicy> {
+    static double weight(const StepResult& result) { return mergeExp.values[result.merges]; }
+};
+
+// Proportional to the reward of a move. The +1 keeps moves without merges possible.
+struct ScorePolicy : WeightedPolicy<ScorePolicy> {
+    static double weight(const StepResult& result) { return result.reward + 1; }
+};
+
+// Follow the policy from state until game over and return the total reward.
+// state must not be terminal.
+template <class Policy, class State>
+int playout(State state, Rng& rng, const Policy& policy = Policy()) {
+    int score = 0;
+    StepResult result = {false, false, 0, 0};
+    while (!result.gameOver) {
+        result = step(state, policy.choose(state, legalMoves(state), rng), rng);
+        score += result.reward;
+    }
+    return score;
+}
+
+// Make firstMove, then follow the policy until game over
+template <class Policy, class State>
+int playout(State state, int firstMove, Rng& rng, const Policy& policy = Policy()) {
+    StepResult result = step(state, firstMove, rng);
+    if (result.gameOver) return result.reward;
+    return result.reward + playout(state, rng, policy);
+}
@@ -1,17 +1,16 @@
 // mcts_score.cpp
 #include "mcts_score.h"
-#include <random>
+#include "flat_search.h"
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <iomanip>
-#include <cmath>
 
 // This uses a policy that tries to maximize score in initial move. Did not work well, so scrapped.
 
-MCTSScore::MCTSScore(int n, int simulations, double c_param) 
-    : game(n), simulations(simulations), points(0) {
+MCTSScore::MCTSScore(int n, int simulations, double c_param, const SearchOptions& options) 
+    : game(n), simulations(simulations), points(0), moveNumber(0), lastMove(-1), simulationsRun(0), simulationsSaved(0), options(options) {
     // Enable nested parallelism
     omp_set_nested(1);
 }
@@ -22,81 +21,11 @@ struct MoveResult {
     bool validMove = false;
 };
 
-int MCTSScore::moveToEnd(int move) {
-    // Create a fresh copy for this simulation
-    Game2048 gameCopy(game);
-    
-    // First apply the move we're testing
-    auto result = gameCopy.move(move);
-    int score = result.reward;
-
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-    
-    // Then do moves that maximize the scores
-    while (!result.gameOver) {
-        // Test each possible move
-        std::vector<double> scores(4);
-        double sum = 0;
-        for (int move = 0; move < 4; move++) {
-            // Test if move is valid using a temporary copy
-            Game2048 testGame(gameCopy);
-            auto moveResult = testGame.moveWithoutSpawn(move);
-            
-            if (!moveResult.changed) {
-                continue;
-            }
-            
-            // The addition by 1 ensures that only moves that change the board are selected
-            scores[move] = moveResult.reward + 1;
-            sum += scores[move];
-        }
-
-        for (int move = 0; move < 4; move++)  {
-            scores[move] /= sum;
-        }
-
-        double val = dis(gen);
-        int nextMove = 0;
-        double cp = 0.0;
-        // Choose move proportional to score
-        for (int move = 0; move < 4; move++)  {
-            cp += scores[move];
-            if(val < cp)  {
-                nextMove = move;
-                break;
-            }
-        }
-
-        result = gameCopy.move(nextMove);
-        score += result.reward;
-    }
-    
-    return score;
-}
-
 bool MCTSScore::makeMove() {
     std::vector<float> rewards(4);
     
     // Test each possible move
-    for (int move = 0; move < 4; move++) {
-        // Test if move is valid using a temporary copy
-        Game2048 testGame(game);
-        auto moveResult = testGame.moveWithoutSpawn(move);
-        
-        if (!moveResult.changed) {
-            rewards[move] = -1;
-            continue;
-        }
-        
-        // Run B simulations for this move
-        int score_sum = 0;
-        #pragma omp parallel for reduction(+:score_sum)
-        for (int sim = 0; sim < simulations; sim++) {
-            score_sum += moveToEnd(move);
-        }
-        rewards[move] = score_sum;
-    }
+    simulationsRun += flatSearch<ScorePolicy>(game.getBoardSet(), moveNumber, simulations, options, rewards, simulationsSaved);
     
     // Find best move
     int bestMove = 0;
@@ -111,6 +40,8 @@ bool MCTSScore::makeMove() {
     // Make the actual move
     auto result = game.move(bestMove);
     points += result.reward;
+    lastMove = bestMove;
+    moveNumber++;
     
     if (result.gameOver) {
         std::cout << "Game over! Total points: " << points << std::endl;
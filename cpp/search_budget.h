@@ -0,0 +1,63 @@
+// search_budget.h
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Wall-clock budget of one move, for searching until a deadline instead of
+// for a fixed number of simulations. Engines look at the clock once per
+// round of simulations, not after every one.
+class Deadline {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Starts now. ms <= 0 means no deadline.
+    explicit Deadline(double ms)
+        : limited(ms > 0), start(Clock::now()),
+          end(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms))) {}
+
+    bool active() const { return limited; }
+    bool passed() const { return limited && Clock::now() >= end; }
+
+    // Deadline at the end of part i of n equal parts, for searches that run
+    // one after another within the move
+    Deadline part(int i, int n) const {
+        Deadline d = *this;
+        d.end = start + (end - start) * (i + 1) / n;
+        return d;
+    }
+
+private:
+    bool limited;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+// Returns seen for one action at the root: their sum, sum of squares and number
+struct ActionStats {
+    double sum = 0;
+    double squares = 0;
+    double count = 0;
+
+    double mean() const { return sum / count; }
+    // Squared standard error of the mean
+    double error() const { return std::max(0.0, squares / count - mean() * mean()) / (count - 1); }
+};
+
+// For stopping a search early: true if the legal action with the highest mean
+// leads every other legal action by more than z standard errors of the
+// difference. Every legal action needs at least two returns.
+inline bool leaderSecure(const ActionStats stats[4], int legal, double z) {
+    int leader = -1;
+    for (int a = 0; a < 4; a++) {
+        if (!(legal & (1 << a))) continue;
+        if (stats[a].count < 2) return false;
+        if (leader < 0 || stats[a].mean() > stats[leader].mean()) leader = a;
+    }
+    for (int a = 0; a < 4; a++) {
+        if (!(legal & (1 << a)) || a == leader) continue;
+        double lead = stats[leader].mean() - stats[a].mean();
+        if (lead <= z * std::sqrt(stats[leader].error() + stats[a].error())) return false;
+    }
+    return true;
+}
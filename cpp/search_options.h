@@ -0,0 +1,47 @@
+// search_options.h
+#pragma once
+#include <cstdint>
+
+// Search settings shared by the engines, set from the command line in main.cpp
+struct SearchOptions {
+    // pUCT: keep the subtree under the played move and the observed spawn as
+    // the next root, and count its visits toward the next move's budget
+    bool reuseTree = true;
+
+    // pUCT and multiple-board pUCT: positions reached by different move
+    // orders share one node. This many are indexed at most, 0 turns it off.
+    uint32_t transpositions = 1 << 20;
+
+    // Every pUCT variant: threads searching each tree at once. Games only
+    // repeat exactly for a given seed with 1.
+    int threads = 1;
+
+    // pUCT: independent trees whose root statistics are summed to pick the
+    // move. They split the budget and are searched in parallel.
+    int ensemble = 1;
+
+    // pUCT: playouts that evaluate a new leaf, run as one SIMD batch. The
+    // leaf's value is their mean, backed up as a single visit.
+    int leafRollouts = 1;
+
+    // Every engine: search each move until this many milliseconds have passed
+    // instead of for a fixed number of simulations. 0 turns it off.
+    double moveTimeMs = 0;
+
+    // Every engine: play a forced move without searching, and stop searching
+    // once the move with the best mean reward leads every other by this many
+    // standard errors. The rest of the budget is left unspent. 0 turns it off.
+    double earlyStop = 0;
+
+    // Multiple-board pUCT: spawn outcomes kept below one chance node. Later
+    // new outcomes are evaluated by a playout without adding a node, so the
+    // tree stops growing with the product of the boards' spawns. 0 for only
+    // the limit of the tree's largest table, see PuctTree::outcomeChild.
+    uint32_t maxOutcomes = 0;
+
+    // Every engine: make use of the board's eight symmetries. The pUCT trees
+    // store each position in its canonical orientation, so mirror images share
+    // one node, and flat Monte Carlo searches only one of the moves that lead
+    // to mirror images of each other.
+    bool symmetry = false;
+};
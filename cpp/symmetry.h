@@ -0,0 +1,106 @@
+// symmetry.h
+#pragma once
+#include <algorithm>
+#include "bitboard.h"
+#include "board_state.h"
+
+// The eight symmetries of the board (rotations and reflections), on packed
+// boards and on moves. 2048 plays the same in every orientation, spawns
+// included, so a search may replace a position by its canonical image, the
+// smallest of the eight, as long as it maps its moves along.
+//
+// Symmetry s mirrors left-right if bit 0 is set, then up-down if bit 1 is
+// set, then transposes if bit 2 is set.
+
+const int NUM_SYMMETRIES = 8;
+
+// Reverse the cells within each row
+inline Board mirrorLeftRight(Board b) {
+    return ((b & 0xF000F000F000F000ULL) >> 12) | ((b & 0x0F000F000F000F00ULL) >> 4) |
+           ((b & 0x00F000F000F000F0ULL) << 4) | ((b & 0x000F000F000F000FULL) << 12);
+}
+
+// Reverse the order of the rows
+inline Board mirrorUpDown(Board b) {
+    return (b >> 48) | ((b >> 16) & 0xFFFF0000ULL) | ((b << 16) & 0xFFFF00000000ULL) | (b << 48);
+}
+
+inline Board applySymmetry(Board b, int s) {
+    if (s & 1) b = mirrorLeftRight(b);
+    if (s & 2) b = mirrorUpDown(b);
+    if (s & 4) b = transpose(b);
+    return b;
+}
+
+inline Board undoSymmetry(Board b, int s) {
+    if (s & 4) b = transpose(b);
+    if (s & 2) b = mirrorUpDown(b);
+    if (s & 1) b = mirrorLeftRight(b);
+    return b;
+}
+
+// Move in the image of a board under s that matches move on the board itself
+// (0=Up, 1=Down, 2=Right, 3=Left)
+inline int applySymmetry(int move, int s) {
+    if (s & 1) move ^= (move >> 1);      // Right and Left swap
+    if (s & 2) move ^= (move < 2);       // Up and Down swap
+    if (s & 4) move = 3 - move;          // Up and Left, Down and Right swap
+    return move;
+}
+
+inline int undoSymmetry(int move, int s) {
+    if (s & 4) move = 3 - move;
+    if (s & 2) move ^= (move < 2);
+    if (s & 1) move ^= (move >> 1);
+    return move;
+}
+
+inline void applySymmetry(BoardState& state, int s) { state.board = applySymmetry(state.board, s); }
+inline void applySymmetry(BoardSet& set, int s) {
+    for (Board& board : set) board = applySymmetry(board, s);
+}
+
+// Symmetry that maps board to its canonical image
+inline int canonicalSymmetry(Board board) {
+    int best = 0;
+    Board bestImage = board;
+    for (int s = 1; s < NUM_SYMMETRIES; s++) {
+        Board image = applySymmetry(board, s);
+        if (image < bestImage) {
+            bestImage = image;
+            best = s;
+        }
+    }
+    return best;
+}
+inline int canonicalSymmetry(const BoardState& state) { return canonicalSymmetry(state.board); }
+
+// Same for a whole set, whose boards all share one orientation since they
+// take the same moves: the images are compared board by board
+inline int canonicalSymmetry(const BoardSet& set) {
+    int best = 0;
+    for (int s = 1; s < NUM_SYMMETRIES; s++) {
+        for (int b = 0; b < set.numBoards; b++) {
+            Board image = applySymmetry(set[b], s);
+            Board bestImage = applySymmetry(set[b], best);
+            if (image != bestImage) {
+                if (image < bestImage) best = s;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+// Lowest move that leads to a mirror image of the position reached by move,
+// through a symmetry that maps the set onto itself. Moves with the same
+// representative have the same value, so one of them need be searched.
+inline int representativeMove(const BoardSet& set, int move) {
+    int lowest = move;
+    for (int s = 1; s < NUM_SYMMETRIES; s++) {
+        bool fixed = true;
+        for (int b = 0; b < set.numBoards && fixed; b++) fixed = applySymmetry(set[b], s) == set[b];
+        if (fixed) lowest = std::min(lowest, applySymmetry(move, s));
+    }
+    return lowest;
+}